@@ -20,8 +20,7 @@
 #define GLFW_INCLUDE_GLEXT
 
 #include "camera.h"
-
-#include "cgmath.h"
+#include "extensions.h"
 
 #include <GLFW/glfw3.h>
 
@@ -73,11 +72,15 @@ void Camera::changeDistance(double deltaZ)
     cameraDistance = distance;
 }
 
-void Camera::loadProjectionMatrix(double aspectRatio) const
+void Camera::setViewport(int width, int height)
+{
+    viewportWidth = width > 0 ? width : 1;
+    viewportHeight = height > 0 ? height : 1;
+}
+
+void Camera::loadProjectionMatrix() const
 {
-    double zNear = 0.1;
-    double zFar = 100.0;
-    double fov = deg2rad(45.0);
+    double aspectRatio = viewportWidth / static_cast<double>(viewportHeight);
 
     double h = zNear * tanf(fov * 0.5);
     double w = h * aspectRatio;
@@ -91,35 +94,103 @@ void Camera::loadViewMatrix() const
 {
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
-
-    Matrix4 translation = Matrix4::translate(0.0, 0.0, -cameraDistance);
-    float translationF[16];
-    translation.toColumnMajor(translationF);
-    glMultMatrixf(translationF);
-
-    Matrix4 pitchRotation = Matrix4::rotateX(deg2rad(-pitch));
-    float pitchRotationF[16];
-    pitchRotation.toColumnMajor(pitchRotationF);
-    glMultMatrixf(pitchRotationF);
-
-    Matrix4 yawRotation = Matrix4::rotateY(deg2rad(-yaw));
-    float yawRotationF[16];
-    yawRotation.toColumnMajor(yawRotationF);
-    glMultMatrixf(yawRotationF);
+    GL::multMatrix(getViewMatrix(false));
 }
 
 void Camera::loadFixedViewMatrix() const
 {
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
+    GL::multMatrix(getViewMatrix(true));
+}
+
+/**
+ * Returns the matrix loaded by loadProjectionMatrix(), as glFrustum builds it.
+ */
+Matrix4f Camera::getProjectionMatrix() const
+{
+    double aspectRatio = viewportWidth / static_cast<double>(viewportHeight);
+
+    double h = zNear * tanf(fov * 0.5);
+    double w = h * aspectRatio;
+
+    Matrix4 m = {
+        zNear / w,         0,                                0,                                      0,
+                0, zNear / h,                                0,                                      0,
+                0,         0, -(zFar + zNear) / (zFar - zNear), -2.0 * zFar * zNear / (zFar - zNear),
+                0,         0,                               -1,                                      0
+    };
+    return m.as<float>();
+}
+
+/**
+ * Returns the matrix loaded by loadViewMatrix() or loadFixedViewMatrix().
+ */
+Matrix4f Camera::getViewMatrix(bool fixedPosition) const
+{
+    Matrix4f pitchRotation = Matrix4f::rotateX(deg2rad(-pitch));
+    Matrix4f yawRotation = Matrix4f::rotateY(deg2rad(-yaw));
+    if (fixedPosition) return pitchRotation * yawRotation;
+
+    Matrix4f translation = Matrix4f::translate(0, 0, -cameraDistance);
+    return translation * pitchRotation * yawRotation;
+}
+
+/**
+ * Extracts the clipping planes from the combined projection and view matrix.
+ *
+ * @param fixedPosition True for scenes rendered with loadFixedViewMatrix().
+ */
+Frustum Camera::getFrustum(bool fixedPosition) const
+{
+    Matrix4f m = getProjectionMatrix() * getViewMatrix(fixedPosition);
+    const float *rows = m.data();
+
+    // left, right, bottom, top, near, far: row 4 plus or minus row 1 to 3
+    Frustum frustum;
+    for (int i = 0; i < 6; i++)
+    {
+        const float *row = rows + (i / 2) * 4;
+        float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        float *plane = frustum.planes[i];
+        for (int j = 0; j < 4; j++) plane[j] = rows[12 + j] + sign * row[j];
+
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        for (int j = 0; j < 4; j++) plane[j] /= length;
+    }
+    return frustum;
+}
+
+/**
+ * Returns the position of the camera in world space.
+ *
+ * @param fixedPosition True for scenes rendered with loadFixedViewMatrix(), where the camera sits in the origin.
+ */
+Vector3 Camera::getPosition(bool fixedPosition) const
+{
+    if (fixedPosition) return Vector3(0.0, 0.0, 0.0);
+
+    Matrix4 orientation = Matrix4::rotateY(deg2rad(yaw)) * Matrix4::rotateX(deg2rad(pitch));
+    return (orientation * Vector4(0.0, 0.0, cameraDistance, 1.0)).xyz();
+}
+
+/**
+ * Estimates the radius in pixels of a sphere after projection to the screen.
+ *
+ * @param center The center of the sphere in world space.
+ * @param radius The radius of the sphere in world space.
+ * @param fixedPosition True for scenes rendered with loadFixedViewMatrix().
+ * @return The projected radius in pixels.
+ */
+double Camera::getProjectedRadius(const Vector3 &center, double radius, bool fixedPosition) const
+{
+    Vector3 eye = getPosition(fixedPosition);
+    double dx = center.x - eye.x;
+    double dy = center.y - eye.y;
+    double dz = center.z - eye.z;
+    double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
 
-    Matrix4 pitchRotation = Matrix4::rotateX(deg2rad(-pitch));
-    float pitchRotationF[16];
-    pitchRotation.toColumnMajor(pitchRotationF);
-    glMultMatrixf(pitchRotationF);
+    if (distance <= radius) return viewportHeight;
 
-    Matrix4 yawRotation = Matrix4::rotateY(deg2rad(-yaw));
-    float yawRotationF[16];
-    yawRotation.toColumnMajor(yawRotationF);
-    glMultMatrixf(yawRotationF);
+    return radius / (distance * std::tan(fov * 0.5)) * viewportHeight * 0.5;
 }
\ No newline at end of file
@@ -19,6 +19,18 @@
 
 #pragma once
 
+#include "cgmath.h"
+
+/**
+ * The six clipping planes of a view frustum in world space. Each plane is
+ * stored as (a, b, c, d) with the normal pointing inside and unit length, so
+ * a * x + b * y + c * z + d is the signed distance of a point.
+ */
+struct Frustum
+{
+    float planes[6][4];
+};
+
 class Camera
 {
   public:
@@ -26,9 +38,15 @@ class Camera
     ~Camera();
     void changePosition(double x, double y);
     void changeDistance(double deltaZ);
-    void loadProjectionMatrix(double aspectRatio) const;
+    void setViewport(int width, int height);
+    void loadProjectionMatrix() const;
     void loadViewMatrix() const;
     void loadFixedViewMatrix() const;
+    Matrix4f getProjectionMatrix() const;
+    Matrix4f getViewMatrix(bool fixedPosition) const;
+    Frustum getFrustum(bool fixedPosition) const;
+    Vector3 getPosition(bool fixedPosition) const;
+    double getProjectedRadius(const Vector3 &center, double radius, bool fixedPosition) const;
 
   private:
     double pitch = 0.0;
@@ -36,6 +54,12 @@ class Camera
 
     double cameraDistance = 0.0;
 
+    double zNear = 0.1;
+    double zFar = 100.0;
+    double fov = deg2rad(45.0);
+    int viewportWidth = 1;
+    int viewportHeight = 1;
+
     double mouseLastX = 0.0;
     double mouseLastY = 0.0;
     double scrollSpeed = 0.1;
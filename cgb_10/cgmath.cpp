@@ -0,0 +1,665 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cgmath.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define CGMATH_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__)
+#define CGMATH_AVX2_TARGET
+#elif defined(CGMATH_X86)
+#define CGMATH_AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+
+static_assert(sizeof(Matrix4) == 16 * sizeof(double), "Matrix4 must consist of 16 packed doubles");
+static_assert(sizeof(Vector4) == 4 * sizeof(double), "Vector4 must consist of 4 packed doubles");
+static_assert(sizeof(Matrix4f) == 16 * sizeof(float), "Matrix4f must consist of 16 packed floats");
+static_assert(sizeof(Vector4f) == 4 * sizeof(float), "Vector4f must consist of 4 packed floats");
+
+namespace Math
+{
+    /**
+     * The matrices are stored row by row (m11, m21, m31, m41 is the first row),
+     * so the kernels work on plain arrays of 16 elements.
+     */
+    template <typename T>
+    struct Kernels
+    {
+        void (*multiplyMatrix)(const T *a, const T *b, T *result);
+        void (*multiplyVector)(const T *m, const T *v, T *result);
+        void (*transform)(const T *m, T w, const T *x, const T *y, const T *z, T *outX, T *outY, T *outZ, size_t count);
+    };
+
+    // Scalar
+
+    template <typename T>
+    static void multiplyMatrixScalar(const T *a, const T *b, T *result)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            for (int column = 0; column < 4; column++)
+            {
+                result[row * 4 + column] = a[row * 4 + 0] * b[0 * 4 + column] +
+                                           a[row * 4 + 1] * b[1 * 4 + column] +
+                                           a[row * 4 + 2] * b[2 * 4 + column] +
+                                           a[row * 4 + 3] * b[3 * 4 + column];
+            }
+        }
+    }
+
+    template <typename T>
+    static void multiplyVectorScalar(const T *m, const T *v, T *result)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            result[row] = m[row * 4 + 0] * v[0] + m[row * 4 + 1] * v[1] + m[row * 4 + 2] * v[2] + m[row * 4 + 3] * v[3];
+        }
+    }
+
+    template <typename T>
+    static void transformScalar(const T *m, T w, const T *x, const T *y, const T *z, T *outX, T *outY, T *outZ, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            T px = x[i], py = y[i], pz = z[i];
+            outX[i] = m[0] * px + m[1] * py + m[2] * pz + m[3] * w;
+            outY[i] = m[4] * px + m[5] * py + m[6] * pz + m[7] * w;
+            outZ[i] = m[8] * px + m[9] * py + m[10] * pz + m[11] * w;
+        }
+    }
+
+    template <typename T>
+    static const Kernels<T> scalarKernels = {multiplyMatrixScalar<T>, multiplyVectorScalar<T>, transformScalar<T>};
+
+#if defined(CGMATH_X86)
+
+    // SSE2, two doubles per register
+
+    static void multiplyMatrixSSE2(const double *a, const double *b, double *result)
+    {
+        __m128d bLow[4], bHigh[4];
+        for (int k = 0; k < 4; k++)
+        {
+            bLow[k] = _mm_loadu_pd(b + k * 4);
+            bHigh[k] = _mm_loadu_pd(b + k * 4 + 2);
+        }
+        for (int row = 0; row < 4; row++)
+        {
+            __m128d low = _mm_setzero_pd();
+            __m128d high = _mm_setzero_pd();
+            for (int k = 0; k < 4; k++)
+            {
+                __m128d factor = _mm_set1_pd(a[row * 4 + k]);
+                low = _mm_add_pd(low, _mm_mul_pd(factor, bLow[k]));
+                high = _mm_add_pd(high, _mm_mul_pd(factor, bHigh[k]));
+            }
+            _mm_storeu_pd(result + row * 4, low);
+            _mm_storeu_pd(result + row * 4 + 2, high);
+        }
+    }
+
+    static void multiplyVectorSSE2(const double *m, const double *v, double *result)
+    {
+        __m128d vLow = _mm_loadu_pd(v);
+        __m128d vHigh = _mm_loadu_pd(v + 2);
+        for (int row = 0; row < 4; row += 2)
+        {
+            __m128d first = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m + row * 4), vLow), _mm_mul_pd(_mm_loadu_pd(m + row * 4 + 2), vHigh));
+            __m128d second = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m + row * 4 + 4), vLow), _mm_mul_pd(_mm_loadu_pd(m + row * 4 + 6), vHigh));
+            __m128d sums = _mm_add_pd(_mm_unpacklo_pd(first, second), _mm_unpackhi_pd(first, second));
+            _mm_storeu_pd(result + row, sums);
+        }
+    }
+
+    static void transformSSE2(const double *m, double w, const double *x, const double *y, const double *z, double *outX, double *outY, double *outZ, size_t count)
+    {
+        __m128d row[3][4];
+        for (int r = 0; r < 3; r++)
+        {
+            for (int c = 0; c < 3; c++) row[r][c] = _mm_set1_pd(m[r * 4 + c]);
+            row[r][3] = _mm_set1_pd(m[r * 4 + 3] * w);
+        }
+
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2)
+        {
+            __m128d px = _mm_loadu_pd(x + i);
+            __m128d py = _mm_loadu_pd(y + i);
+            __m128d pz = _mm_loadu_pd(z + i);
+            double *out[3] = {outX, outY, outZ};
+            for (int r = 0; r < 3; r++)
+            {
+                __m128d sum = _mm_add_pd(_mm_add_pd(_mm_mul_pd(row[r][0], px), _mm_mul_pd(row[r][1], py)), _mm_add_pd(_mm_mul_pd(row[r][2], pz), row[r][3]));
+                _mm_storeu_pd(out[r] + i, sum);
+            }
+        }
+        transformScalar<double>(m, w, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+    }
+
+    static const Kernels<double> sse2Kernels = {multiplyMatrixSSE2, multiplyVectorSSE2, transformSSE2};
+
+    // AVX2 with FMA, one matrix row per register
+
+    CGMATH_AVX2_TARGET static void multiplyMatrixAVX2(const double *a, const double *b, double *result)
+    {
+        __m256d b0 = _mm256_loadu_pd(b);
+        __m256d b1 = _mm256_loadu_pd(b + 4);
+        __m256d b2 = _mm256_loadu_pd(b + 8);
+        __m256d b3 = _mm256_loadu_pd(b + 12);
+        for (int row = 0; row < 4; row++)
+        {
+            __m256d sum = _mm256_mul_pd(_mm256_broadcast_sd(a + row * 4), b0);
+            sum = _mm256_fmadd_pd(_mm256_broadcast_sd(a + row * 4 + 1), b1, sum);
+            sum = _mm256_fmadd_pd(_mm256_broadcast_sd(a + row * 4 + 2), b2, sum);
+            sum = _mm256_fmadd_pd(_mm256_broadcast_sd(a + row * 4 + 3), b3, sum);
+            _mm256_storeu_pd(result + row * 4, sum);
+        }
+    }
+
+    CGMATH_AVX2_TARGET static void transformAVX2(const double *m, double w, const double *x, const double *y, const double *z, double *outX, double *outY, double *outZ, size_t count)
+    {
+        __m256d row[3][4];
+        for (int r = 0; r < 3; r++)
+        {
+            for (int c = 0; c < 3; c++) row[r][c] = _mm256_set1_pd(m[r * 4 + c]);
+            row[r][3] = _mm256_set1_pd(m[r * 4 + 3] * w);
+        }
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m256d px = _mm256_loadu_pd(x + i);
+            __m256d py = _mm256_loadu_pd(y + i);
+            __m256d pz = _mm256_loadu_pd(z + i);
+            double *out[3] = {outX, outY, outZ};
+            for (int r = 0; r < 3; r++)
+            {
+                __m256d sum = _mm256_fmadd_pd(row[r][0], px, row[r][3]);
+                sum = _mm256_fmadd_pd(row[r][1], py, sum);
+                sum = _mm256_fmadd_pd(row[r][2], pz, sum);
+                _mm256_storeu_pd(out[r] + i, sum);
+            }
+        }
+        transformScalar<double>(m, w, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+    }
+
+    // A single matrix-vector product needs horizontal adds in 256 bit registers,
+    // which measured slower than the SSE2 version, so that one is reused.
+    static const Kernels<double> avx2Kernels = {multiplyMatrixAVX2, multiplyVectorSSE2, transformAVX2};
+
+    // SSE, four floats per register
+
+    static void multiplyMatrixSSEf(const float *a, const float *b, float *result)
+    {
+        __m128 b0 = _mm_loadu_ps(b);
+        __m128 b1 = _mm_loadu_ps(b + 4);
+        __m128 b2 = _mm_loadu_ps(b + 8);
+        __m128 b3 = _mm_loadu_ps(b + 12);
+        for (int row = 0; row < 4; row++)
+        {
+            __m128 sum = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[row * 4]), b0), _mm_mul_ps(_mm_set1_ps(a[row * 4 + 1]), b1));
+            sum = _mm_add_ps(sum, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[row * 4 + 2]), b2), _mm_mul_ps(_mm_set1_ps(a[row * 4 + 3]), b3)));
+            _mm_storeu_ps(result + row * 4, sum);
+        }
+    }
+
+    static void multiplyVectorSSEf(const float *m, const float *v, float *result)
+    {
+        __m128 r0 = _mm_loadu_ps(m);
+        __m128 r1 = _mm_loadu_ps(m + 4);
+        __m128 r2 = _mm_loadu_ps(m + 8);
+        __m128 r3 = _mm_loadu_ps(m + 12);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        __m128 sum = _mm_add_ps(_mm_mul_ps(r0, _mm_set1_ps(v[0])), _mm_mul_ps(r1, _mm_set1_ps(v[1])));
+        sum = _mm_add_ps(sum, _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(v[2])), _mm_mul_ps(r3, _mm_set1_ps(v[3]))));
+        _mm_storeu_ps(result, sum);
+    }
+
+    static void transformSSEf(const float *m, float w, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ, size_t count)
+    {
+        __m128 row[3][4];
+        for (int r = 0; r < 3; r++)
+        {
+            for (int c = 0; c < 3; c++) row[r][c] = _mm_set1_ps(m[r * 4 + c]);
+            row[r][3] = _mm_set1_ps(m[r * 4 + 3] * w);
+        }
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 px = _mm_loadu_ps(x + i);
+            __m128 py = _mm_loadu_ps(y + i);
+            __m128 pz = _mm_loadu_ps(z + i);
+            float *out[3] = {outX, outY, outZ};
+            for (int r = 0; r < 3; r++)
+            {
+                __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(row[r][0], px), _mm_mul_ps(row[r][1], py)), _mm_add_ps(_mm_mul_ps(row[r][2], pz), row[r][3]));
+                _mm_storeu_ps(out[r] + i, sum);
+            }
+        }
+        transformScalar<float>(m, w, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+    }
+
+    static const Kernels<float> sse2KernelsFloat = {multiplyMatrixSSEf, multiplyVectorSSEf, transformSSEf};
+
+    // AVX2 with FMA, eight points per register
+
+    CGMATH_AVX2_TARGET static void transformAVX2f(const float *m, float w, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ, size_t count)
+    {
+        __m256 row[3][4];
+        for (int r = 0; r < 3; r++)
+        {
+            for (int c = 0; c < 3; c++) row[r][c] = _mm256_set1_ps(m[r * 4 + c]);
+            row[r][3] = _mm256_set1_ps(m[r * 4 + 3] * w);
+        }
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 px = _mm256_loadu_ps(x + i);
+            __m256 py = _mm256_loadu_ps(y + i);
+            __m256 pz = _mm256_loadu_ps(z + i);
+            float *out[3] = {outX, outY, outZ};
+            for (int r = 0; r < 3; r++)
+            {
+                __m256 sum = _mm256_fmadd_ps(row[r][0], px, row[r][3]);
+                sum = _mm256_fmadd_ps(row[r][1], py, sum);
+                sum = _mm256_fmadd_ps(row[r][2], pz, sum);
+                _mm256_storeu_ps(out[r] + i, sum);
+            }
+        }
+        transformScalar<float>(m, w, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+    }
+
+    // A float matrix already fits into one SSE register per row, so only the
+    // batch transform gains from the wider registers.
+    static const Kernels<float> avx2KernelsFloat = {multiplyMatrixSSEf, multiplyVectorSSEf, transformAVX2f};
+
+#endif
+
+    template <typename T>
+    static const Kernels<T> &getKernels(InstructionSet instructionSet)
+    {
+#if defined(CGMATH_X86)
+        if constexpr (std::is_same_v<T, float>)
+        {
+            if (instructionSet == InstructionSet::AVX2) return avx2KernelsFloat;
+            if (instructionSet == InstructionSet::SSE2) return sse2KernelsFloat;
+        }
+        else
+        {
+            if (instructionSet == InstructionSet::AVX2) return avx2Kernels;
+            if (instructionSet == InstructionSet::SSE2) return sse2Kernels;
+        }
+#endif
+        return scalarKernels<T>;
+    }
+
+    bool isSupported(InstructionSet instructionSet)
+    {
+        switch (instructionSet)
+        {
+            case InstructionSet::Scalar:
+                return true;
+#if defined(CGMATH_X86)
+            case InstructionSet::SSE2:
+                return true;
+            case InstructionSet::AVX2:
+#if defined(__AVX2__) && defined(__FMA__)
+                return true;
+#else
+                return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#endif
+            default:
+                return false;
+        }
+    }
+
+    static InstructionSet detectInstructionSet()
+    {
+        if (isSupported(InstructionSet::AVX2)) return InstructionSet::AVX2;
+        if (isSupported(InstructionSet::SSE2)) return InstructionSet::SSE2;
+        return InstructionSet::Scalar;
+    }
+
+    // Starts out scalar, so matrices used during static initialization work as well.
+    static InstructionSet activeInstructionSet = InstructionSet::Scalar;
+    static const Kernels<double> *active = &scalarKernels<double>;
+    static const Kernels<float> *activeFloat = &scalarKernels<float>;
+    [[maybe_unused]] static const bool initialized = (setInstructionSet(detectInstructionSet()), true);
+
+    InstructionSet getInstructionSet()
+    {
+        return activeInstructionSet;
+    }
+
+    void setInstructionSet(InstructionSet instructionSet)
+    {
+        if (!isSupported(instructionSet)) return;
+        activeInstructionSet = instructionSet;
+        active = &getKernels<double>(instructionSet);
+        activeFloat = &getKernels<float>(instructionSet);
+    }
+
+    const char *getName(InstructionSet instructionSet)
+    {
+        switch (instructionSet)
+        {
+            case InstructionSet::SSE2:
+                return "SSE2";
+            case InstructionSet::AVX2:
+                return "AVX2";
+            default:
+                return "Scalar";
+        }
+    }
+
+    template <typename T>
+    static const Kernels<T> &activeKernels()
+    {
+        if constexpr (std::is_same_v<T, float>) return *activeFloat;
+        else return *active;
+    }
+
+    template <typename T>
+    static Matrix4T<T> multiplyMatrix(const Matrix4T<T> &a, const Matrix4T<T> &b)
+    {
+        Matrix4T<T> result;
+        activeKernels<T>().multiplyMatrix(a.data(), b.data(), &result.m11);
+        return result;
+    }
+
+    template <typename T>
+    static Vector4T<T> multiplyVector(const Matrix4T<T> &m, const Vector4T<T> &v)
+    {
+        Vector4T<T> result(0, 0, 0, 0);
+        activeKernels<T>().multiplyVector(m.data(), &v.x, &result.x);
+        return result;
+    }
+
+    Matrix4 multiply(const Matrix4 &a, const Matrix4 &b)
+    {
+        return multiplyMatrix(a, b);
+    }
+
+    Matrix4f multiply(const Matrix4f &a, const Matrix4f &b)
+    {
+        return multiplyMatrix(a, b);
+    }
+
+    Vector4 multiply(const Matrix4 &m, const Vector4 &v)
+    {
+        return multiplyVector(m, v);
+    }
+
+    Vector4f multiply(const Matrix4f &m, const Vector4f &v)
+    {
+        return multiplyVector(m, v);
+    }
+
+    /**
+     * Transforms count points given as separate x, y and z arrays (w = 1).
+     * The input and output arrays may be the same.
+     */
+    void transformPoints(const Matrix4 &m, const double *x, const double *y, const double *z, double *outX, double *outY, double *outZ, size_t count)
+    {
+        active->transform(m.data(), 1.0, x, y, z, outX, outY, outZ, count);
+    }
+
+    void transformPoints(const Matrix4f &m, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ, size_t count)
+    {
+        activeFloat->transform(m.data(), 1.0f, x, y, z, outX, outY, outZ, count);
+    }
+
+    /**
+     * Transforms count directions given as separate x, y and z arrays (w = 0),
+     * e.g. normals under rotations and uniform scaling.
+     */
+    void transformDirections(const Matrix4 &m, const double *x, const double *y, const double *z, double *outX, double *outY, double *outZ, size_t count)
+    {
+        active->transform(m.data(), 0.0, x, y, z, outX, outY, outZ, count);
+    }
+
+    void transformDirections(const Matrix4f &m, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ, size_t count)
+    {
+        activeFloat->transform(m.data(), 0.0f, x, y, z, outX, outY, outZ, count);
+    }
+
+    static void testSpheresScalar(const float (*planes)[4], int planeCount, const float *x, const float *y, const float *z, const float *radius, uint8_t *inside, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            bool visible = true;
+            for (int p = 0; p < planeCount && visible; p++)
+            {
+                visible = planes[p][0] * x[i] + planes[p][1] * y[i] + planes[p][2] * z[i] + planes[p][3] > -radius[i];
+            }
+            inside[i] = visible;
+        }
+    }
+
+#if defined(CGMATH_X86)
+    static void testSpheresSSE(const float (*planes)[4], int planeCount, const float *x, const float *y, const float *z, const float *radius, uint8_t *inside, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 px = _mm_loadu_ps(x + i);
+            __m128 py = _mm_loadu_ps(y + i);
+            __m128 pz = _mm_loadu_ps(z + i);
+            __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+            __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < planeCount; p++)
+            {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p][0]), px), _mm_mul_ps(_mm_set1_ps(planes[p][1]), py)),
+                                             _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p][2]), pz), _mm_set1_ps(planes[p][3])));
+                visible = _mm_and_ps(visible, _mm_cmpgt_ps(distance, negativeRadius));
+            }
+            int mask = _mm_movemask_ps(visible);
+            for (int j = 0; j < 4; j++) inside[i + j] = (mask >> j) & 1;
+        }
+        testSpheresScalar(planes, planeCount, x + i, y + i, z + i, radius + i, inside + i, count - i);
+    }
+#endif
+
+    /**
+     * Tests count spheres, given as separate center and radius arrays, against
+     * a set of planes whose normals point inside. inside[i] becomes 1 if the
+     * sphere is not completely behind any of the planes. All instruction sets
+     * above scalar share the four-wide SSE version, a single frustum test has
+     * too little work per sphere to gain from wider registers.
+     */
+    void testSpheres(const float (*planes)[4], int planeCount, const float *x, const float *y, const float *z, const float *radius, uint8_t *inside, size_t count)
+    {
+#if defined(CGMATH_X86)
+        if (activeInstructionSet != InstructionSet::Scalar)
+        {
+            testSpheresSSE(planes, planeCount, x, y, z, radius, inside, count);
+            return;
+        }
+#endif
+        testSpheresScalar(planes, planeCount, x, y, z, radius, inside, count);
+    }
+
+    template <typename T>
+    static bool nearlyEqual(T a, T b)
+    {
+        // Float kernels may contract to FMA, so they get a looser tolerance.
+        const T epsilon = std::is_same_v<T, float> ? T(1e-5) : T(1e-12);
+        return std::abs(a - b) <= epsilon * std::max(T(1), std::max(std::abs(a), std::abs(b)));
+    }
+
+    template <typename T>
+    static bool verifyKernels(const char *precision)
+    {
+        std::mt19937 random(42);
+        std::uniform_real_distribution<T> distribution(-10, 10);
+
+        const size_t count = 1027;
+        std::vector<T> input(16 * 3 + 4 + count * 3);
+        for (T &value : input) value = distribution(random);
+        const T *a = input.data();
+        const T *b = a + 16;
+        const T *m = b + 16;
+        const T *v = m + 16;
+        const T *x = v + 4;
+        const T *y = x + count;
+        const T *z = y + count;
+
+        T expectedMatrix[16], expectedVector[4];
+        std::vector<T> expected(count * 3);
+        scalarKernels<T>.multiplyMatrix(a, b, expectedMatrix);
+        scalarKernels<T>.multiplyVector(m, v, expectedVector);
+
+        bool allPassed = true;
+        for (InstructionSet instructionSet : {InstructionSet::Scalar, InstructionSet::SSE2, InstructionSet::AVX2})
+        {
+            if (!isSupported(instructionSet)) continue;
+            const Kernels<T> &kernels = getKernels<T>(instructionSet);
+
+            T matrix[16], vector[4];
+            std::vector<T> output(count * 3);
+            kernels.multiplyMatrix(a, b, matrix);
+            kernels.multiplyVector(m, v, vector);
+
+            bool passed = std::equal(matrix, matrix + 16, expectedMatrix, nearlyEqual<T>) && std::equal(vector, vector + 4, expectedVector, nearlyEqual<T>);
+
+            for (T w : {T(1), T(0)})
+            {
+                scalarKernels<T>.transform(m, w, x, y, z, expected.data(), expected.data() + count, expected.data() + 2 * count, count);
+                kernels.transform(m, w, x, y, z, output.data(), output.data() + count, output.data() + 2 * count, count);
+                passed = passed && std::equal(output.begin(), output.end(), expected.begin(), nearlyEqual<T>);
+            }
+
+            std::printf("%-8s %-7s %s\n", getName(instructionSet), precision, passed ? "matches scalar" : "MISMATCH");
+            allPassed = allPassed && passed;
+        }
+        return allPassed;
+    }
+
+    /**
+     * Compares every supported instruction set against the scalar kernels on
+     * random input in both precisions and prints the result.
+     *
+     * @return True if all kernels agree with the scalar implementation.
+     */
+    bool verify()
+    {
+        bool passed = verifyKernels<double>("double");
+        passed = verifyKernels<float>("float") && passed;
+
+#if defined(CGMATH_X86)
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+        const size_t count = 1023;
+        float planes[6][4];
+        for (auto &plane : planes)
+        {
+            for (float &value : plane) value = distribution(random);
+        }
+        std::vector<float> spheres(count * 4);
+        for (float &value : spheres) value = distribution(random);
+        for (size_t i = 0; i < count; i++) spheres[3 * count + i] = std::abs(spheres[3 * count + i]);
+
+        std::vector<uint8_t> expected(count), output(count);
+        const float *x = spheres.data();
+        testSpheresScalar(planes, 6, x, x + count, x + 2 * count, x + 3 * count, expected.data(), count);
+        testSpheresSSE(planes, 6, x, x + count, x + 2 * count, x + 3 * count, output.data(), count);
+        bool spheresPassed = expected == output;
+        std::printf("%-8s %-7s %s\n", "SSE2", "spheres", spheresPassed ? "matches scalar" : "MISMATCH");
+        passed = passed && spheresPassed;
+#endif
+        return passed;
+    }
+
+    template <typename T>
+    static void printBenchmark(const char *precision)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        const int iterations = 10000000;
+        const size_t count = 1 << 16;
+        const int batches = 200;
+
+        std::vector<T> points(count * 3, T(1));
+        Matrix4T<T> m = Matrix4T<T>::rotateX(T(0.3)) * Matrix4T<T>::rotateY(T(0.2)) * Matrix4T<T>::translate(1, 2, 3);
+
+        for (InstructionSet instructionSet : {InstructionSet::Scalar, InstructionSet::SSE2, InstructionSet::AVX2})
+        {
+            if (!isSupported(instructionSet)) continue;
+            const Kernels<T> &kernels = getKernels<T>(instructionSet);
+            const T *matrix = m.data();
+
+            T accumulator[16];
+            std::copy(matrix, matrix + 16, accumulator);
+            auto start = Clock::now();
+            for (int i = 0; i < iterations; i++)
+            {
+                T result[16];
+                kernels.multiplyMatrix(accumulator, matrix, result);
+                std::copy(result, result + 16, accumulator);
+            }
+            double matrixTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+
+            T vector[4] = {1, 0, 0, 1};
+            start = Clock::now();
+            for (int i = 0; i < iterations; i++)
+            {
+                T result[4];
+                kernels.multiplyVector(matrix, vector, result);
+                std::copy(result, result + 4, vector);
+            }
+            double vectorTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+
+            T *x = points.data();
+            T *y = x + count;
+            T *z = y + count;
+            start = Clock::now();
+            for (int i = 0; i < batches; i++)
+            {
+                kernels.transform(matrix, T(1), x, y, z, x, y, z, count);
+            }
+            double pointTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (batches * count);
+
+            std::printf("%-8s %-7s %16.2f %16.2f %16.3f   (checksum %g)\n", getName(instructionSet), precision, matrixTime, vectorTime, pointTime,
+                        static_cast<double>(accumulator[0] + vector[0] + x[0]));
+        }
+    }
+
+    /**
+     * Times the kernels of every supported instruction set in both precisions.
+     */
+    void printBenchmark()
+    {
+        std::printf("%-8s %-7s %16s %16s %16s\n", "", "", "mat*mat [ns]", "mat*vec [ns]", "points [ns/pt]");
+        printBenchmark<double>("double");
+        printBenchmark<float>("float");
+    }
+}
@@ -20,63 +20,112 @@
 #pragma once
 
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <numbers>
 
+/**
+ * The math types are templated on their scalar type. Simulation code works
+ * with the double aliases (Vector3, Matrix4, ...), render-side data uses the
+ * float aliases (Vector3f, Matrix4f, ...) and is converted once with as<U>()
+ * where it crosses over.
+ */
+
 inline double deg2rad(double deg)
 {
     return deg * std::numbers::pi / 180.0;
 }
 
-struct Vector2
+template <typename T>
+struct Vector2T
 {
-    double x;
-    double y;
+    T x;
+    T y;
+
+    template <typename U>
+    Vector2T<U> as() const
+    {
+        return {static_cast<U>(x), static_cast<U>(y)};
+    }
 };
 
-struct Vector3
+template <typename T>
+struct Vector3T
 {
-    double x;
-    double y;
-    double z;
+    T x;
+    T y;
+    T z;
+
+    template <typename U>
+    Vector3T<U> as() const
+    {
+        return {static_cast<U>(x), static_cast<U>(y), static_cast<U>(z)};
+    }
 };
 
-struct Vector4
+template <typename T>
+struct Vector4T
 {
-    double x;
-    double y;
-    double z;
-    double w;
+    T x;
+    T y;
+    T z;
+    T w;
 
-    Vector4(double x, double y, double z, double w)
+    Vector4T(T x, T y, T z, T w)
         : x(x), y(y), z(z), w(w)
     {
     }
 
-    Vector4(Vector3 v, double w)
+    Vector4T(Vector3T<T> v, T w)
         : x(v.x), y(v.y), z(v.z), w(w)
     {
     }
 
-    Vector3 xyz()
+    Vector3T<T> xyz() const
     {
         return {x, y, z};
     }
+
+    template <typename U>
+    Vector4T<U> as() const
+    {
+        return {static_cast<U>(x), static_cast<U>(y), static_cast<U>(z), static_cast<U>(w)};
+    }
 };
 
-struct Color
+template <typename T>
+struct ColorT
 {
-    double r;
-    double g;
-    double b;
-    double a;
+    T r;
+    T g;
+    T b;
+    T a;
+
+    template <typename U>
+    ColorT<U> as() const
+    {
+        return {static_cast<U>(r), static_cast<U>(g), static_cast<U>(b), static_cast<U>(a)};
+    }
 };
 
+using Vector2 = Vector2T<double>;
+using Vector3 = Vector3T<double>;
+using Vector4 = Vector4T<double>;
+using Color = ColorT<double>;
+
+using Vector2f = Vector2T<float>;
+using Vector3f = Vector3T<float>;
+using Vector4f = Vector4T<float>;
+using Colorf = ColorT<float>;
+
 struct Vertex
 {
-    Vertex(const Vector3 &position, const Vector3 &norm, const Vector2 &texcoord)
-        : position(static_cast<float>(position.x), static_cast<float>(position.y), static_cast<float>(position.z)),
-          normal(static_cast<float>(norm.x), static_cast<float>(norm.y), static_cast<float>(norm.z)),
-          texcoord(static_cast<float>(texcoord.x), static_cast<float>(texcoord.y))
+    Vertex() = default;
+
+    Vertex(const Vector3f &position, const Vector3f &norm, const Vector2f &texcoord)
+        : position(position.x, position.y, position.z),
+          normal(norm.x, norm.y, norm.z),
+          texcoord(texcoord.x, texcoord.y)
     {
     }
 
@@ -85,12 +134,50 @@ struct Vertex
     float texcoord[2];
 };
 
-struct Matrix4
+template <typename T>
+struct Matrix4T;
+
+/**
+ * Matrix kernels with scalar, SSE2 and AVX2 implementations for both
+ * precisions.
+ *
+ * The best instruction set is chosen at compile time if the compiler already
+ * targets AVX2, otherwise once at startup from the features of the CPU.
+ */
+namespace Math
+{
+    enum class InstructionSet
+    {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    Matrix4T<double> multiply(const Matrix4T<double> &a, const Matrix4T<double> &b);
+    Matrix4T<float> multiply(const Matrix4T<float> &a, const Matrix4T<float> &b);
+    Vector4T<double> multiply(const Matrix4T<double> &m, const Vector4T<double> &v);
+    Vector4T<float> multiply(const Matrix4T<float> &m, const Vector4T<float> &v);
+    void transformPoints(const Matrix4T<double> &m, const double *x, const double *y, const double *z, double *outX, double *outY, double *outZ, size_t count);
+    void transformPoints(const Matrix4T<float> &m, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ, size_t count);
+    void transformDirections(const Matrix4T<double> &m, const double *x, const double *y, const double *z, double *outX, double *outY, double *outZ, size_t count);
+    void transformDirections(const Matrix4T<float> &m, const float *x, const float *y, const float *z, float *outX, float *outY, float *outZ, size_t count);
+    void testSpheres(const float (*planes)[4], int planeCount, const float *x, const float *y, const float *z, const float *radius, uint8_t *inside, size_t count);
+
+    bool isSupported(InstructionSet instructionSet);
+    InstructionSet getInstructionSet();
+    void setInstructionSet(InstructionSet instructionSet);
+    const char *getName(InstructionSet instructionSet);
+    bool verify();
+    void printBenchmark();
+}
+
+template <typename T>
+struct Matrix4T
 {
-    double m11;  double m21;  double m31;  double m41;
-    double m12;  double m22;  double m32;  double m42;
-    double m13;  double m23;  double m33;  double m43;
-    double m14;  double m24;  double m34;  double m44;
+    T m11;  T m21;  T m31;  T m41;
+    T m12;  T m22;  T m32;  T m42;
+    T m13;  T m23;  T m33;  T m43;
+    T m14;  T m24;  T m34;  T m44;
 
     /**
      * Creates a translation matrix that translates points
@@ -101,9 +188,9 @@ struct Matrix4
      * @param z The translation distance along the z-axis.
      * @return The translation matrix.
      */
-    static Matrix4 translate(double x, double y, double z)
+    static Matrix4T translate(T x, T y, T z)
     {
-        Matrix4 m = {
+        Matrix4T m = {
             1, 0, 0, x,
             0, 1, 0, y,
             0, 0, 1, z,
@@ -118,13 +205,13 @@ struct Matrix4
      * @param a The angle of rotation in radians.
      * @return The rotation matrix.
      */
-    static Matrix4 rotateX(double a)
+    static Matrix4T rotateX(T a)
     {
-        Matrix4 m = {
-            1,      0,       0, 0,
-            0, cos(a), -sin(a), 0,
-            0, sin(a),  cos(a), 0,
-            0,      0,       0, 1
+        Matrix4T m = {
+            1,           0,            0, 0,
+            0, std::cos(a), -std::sin(a), 0,
+            0, std::sin(a),  std::cos(a), 0,
+            0,           0,            0, 1
         };
         return m;
     }
@@ -135,13 +222,13 @@ struct Matrix4
      * @param a The angle of rotation in radians.
      * @return The rotation matrix.
      */
-    static Matrix4 rotateY(double a)
+    static Matrix4T rotateY(T a)
     {
-        Matrix4 m = {
-             cos(a), 0, sin(a), 0,
-                  0, 1,      0, 0,
-            -sin(a), 0, cos(a), 0,
-                  0, 0,      0, 1
+        Matrix4T m = {
+             std::cos(a), 0, std::sin(a), 0,
+                       0, 1,           0, 0,
+            -std::sin(a), 0, std::cos(a), 0,
+                       0, 0,           0, 1
         };
         return m;
     }
@@ -152,13 +239,13 @@ struct Matrix4
      * @param a The angle of rotation in radians.
      * @return The rotation matrix.
      */
-    static Matrix4 rotateZ(double a)
+    static Matrix4T rotateZ(T a)
     {
-        Matrix4 m = {
-            cos(a), -sin(a), 0, 0,
-            sin(a),  cos(a), 0, 0,
-                 0,       0, 1, 0,
-                 0,       0, 0, 1
+        Matrix4T m = {
+            std::cos(a), -std::sin(a), 0, 0,
+            std::sin(a),  std::cos(a), 0, 0,
+                      0,            0, 1, 0,
+                      0,            0, 0, 1
         };
         return m;
     }
@@ -169,9 +256,9 @@ struct Matrix4
      * @param a The scaling factor.
      * @return The scaling matrix.
      */
-    static Matrix4 scale(double a)
+    static Matrix4T scale(T a)
     {
-        Matrix4 m = {
+        Matrix4T m = {
             a, 0, 0, 0,
             0, a, 0, 0,
             0, 0, a, 0,
@@ -189,30 +276,9 @@ struct Matrix4
      * @param b The right-hand side Matrix4 to be multiplied with the current instance.
      * @return Matrix4 The result of the matrix multiplication.
      */
-    Matrix4 operator*(const Matrix4 &b) const
+    Matrix4T operator*(const Matrix4T &b) const
     {
-        Matrix4 result = {
-            m11 * b.m11 + m21 * b.m12 + m31 * b.m13 + m41 * b.m14,
-            m11 * b.m21 + m21 * b.m22 + m31 * b.m23 + m41 * b.m24,
-            m11 * b.m31 + m21 * b.m32 + m31 * b.m33 + m41 * b.m34,
-            m11 * b.m41 + m21 * b.m42 + m31 * b.m43 + m41 * b.m44,
-            
-            m12 * b.m11 + m22 * b.m12 + m32 * b.m13 + m42 * b.m14,
-            m12 * b.m21 + m22 * b.m22 + m32 * b.m23 + m42 * b.m24,
-            m12 * b.m31 + m22 * b.m32 + m32 * b.m33 + m42 * b.m34,
-            m12 * b.m41 + m22 * b.m42 + m32 * b.m43 + m42 * b.m44,
-            
-            m13 * b.m11 + m23 * b.m12 + m33 * b.m13 + m43 * b.m14,
-            m13 * b.m21 + m23 * b.m22 + m33 * b.m23 + m43 * b.m24,
-            m13 * b.m31 + m23 * b.m32 + m33 * b.m33 + m43 * b.m34,
-            m13 * b.m41 + m23 * b.m42 + m33 * b.m43 + m43 * b.m44,
-            
-            m14 * b.m11 + m24 * b.m12 + m34 * b.m13 + m44 * b.m14,
-            m14 * b.m21 + m24 * b.m22 + m34 * b.m23 + m44 * b.m24,
-            m14 * b.m31 + m24 * b.m32 + m34 * b.m33 + m44 * b.m34,
-            m14 * b.m41 + m24 * b.m42 + m34 * b.m43 + m44 * b.m44
-        };
-        return result;
+        return Math::multiply(*this, b);
     }
 
     /**
@@ -225,15 +291,33 @@ struct Matrix4
      * @param v The Vector4 to be multiplied by this matrix.
      * @return A new Vector4 that is the result of the matrix-vector multiplication.
      */
-    Vector4 operator*(const Vector4 &v) const
+    Vector4T<T> operator*(const Vector4T<T> &v) const
     {
-        Vector4 result = {
-            m11 * v.x + m21 * v.y + m31 * v.z + m41 * v.w,
-            m12 * v.x + m22 * v.y + m32 * v.z + m42 * v.w,
-            m13 * v.x + m23 * v.y + m33 * v.z + m43 * v.w,
-            m14 * v.x + m24 * v.y + m34 + v.z + m44 * v.w
+        return Math::multiply(*this, v);
+    }
+
+    /**
+     * Converts the matrix to another scalar type.
+     *
+     * @return The matrix with all elements converted to U.
+     */
+    template <typename U>
+    Matrix4T<U> as() const
+    {
+        return {
+            static_cast<U>(m11), static_cast<U>(m21), static_cast<U>(m31), static_cast<U>(m41),
+            static_cast<U>(m12), static_cast<U>(m22), static_cast<U>(m32), static_cast<U>(m42),
+            static_cast<U>(m13), static_cast<U>(m23), static_cast<U>(m33), static_cast<U>(m43),
+            static_cast<U>(m14), static_cast<U>(m24), static_cast<U>(m34), static_cast<U>(m44)
         };
-        return result;
+    }
+
+    /**
+     * Returns the elements row by row, the layout expected by glLoadTransposeMatrix.
+     */
+    const T *data() const
+    {
+        return &m11;
     }
 
     /**
@@ -260,4 +344,7 @@ struct Matrix4
         values[14] = static_cast<float>(m43);
         values[15] = static_cast<float>(m44);
     }
-};
\ No newline at end of file
+};
+
+using Matrix4 = Matrix4T<double>;
+using Matrix4f = Matrix4T<float>;
@@ -19,42 +19,49 @@
 
 #include "cube.h"
 
+#include "geometrycache.h"
+
 Cube::Cube(std::shared_ptr<Texture> &texture)
     : Mesh(texture)
 {
-    Vector3 p1(-1, -1, 1);
-    Vector3 p2( 1, -1, 1);
-    Vector3 p3( 1,  1, 1);
-    Vector3 p4(-1,  1, 1);
-    Vector3 normal(0, 0, 1);
-    Vector2 t1(0, 0);
-    Vector2 t2(1, 0);
-    Vector2 t3(1, 1);
-    Vector2 t4(0, 1);
-
-    vertices.emplace_back(p1, normal, t1);
-    vertices.emplace_back(p2, normal, t2);
-    vertices.emplace_back(p3, normal, t3);
-    vertices.emplace_back(p4, normal, t4);
-    for (int i = 1; i < 6; i++)
+    geometry = GeometryCache::get({Shape::Cube, 0, Winding::CounterClockwise}, [](Geometry &geometry)
     {
-        Matrix4 rotationMatrix;
-        if (i <= 3) rotationMatrix = Matrix4::rotateY(deg2rad(90.0 * i));
-        if (i == 4) rotationMatrix = Matrix4::rotateX(deg2rad(90.0));
-        if (i == 5) rotationMatrix = Matrix4::rotateX(deg2rad(-90.0));
+        std::vector<Vertex> &vertices = geometry.vertices;
+
+        Vector3f p1(-1, -1, 1);
+        Vector3f p2( 1, -1, 1);
+        Vector3f p3( 1,  1, 1);
+        Vector3f p4(-1,  1, 1);
+        Vector3f normal(0, 0, 1);
+        Vector2f t1(0, 0);
+        Vector2f t2(1, 0);
+        Vector2f t3(1, 1);
+        Vector2f t4(0, 1);
+
+        vertices.emplace_back(p1, normal, t1);
+        vertices.emplace_back(p2, normal, t2);
+        vertices.emplace_back(p3, normal, t3);
+        vertices.emplace_back(p4, normal, t4);
+        for (int i = 1; i < 6; i++)
+        {
+            Matrix4f rotationMatrix;
+            if (i <= 3) rotationMatrix = Matrix4f::rotateY(deg2rad(90.0 * i));
+            if (i == 4) rotationMatrix = Matrix4f::rotateX(deg2rad(90.0));
+            if (i == 5) rotationMatrix = Matrix4f::rotateX(deg2rad(-90.0));
 
-        Vector3 normalRotated = (rotationMatrix * Vector4(normal, 1)).xyz();
+            Vector3f normalRotated = (rotationMatrix * Vector4f(normal, 1)).xyz();
 
-        Vector4 result = rotationMatrix * Vector4(p1, 1.0);
-        vertices.emplace_back(result.xyz(), normalRotated, t1);
+            Vector4f result = rotationMatrix * Vector4f(p1, 1.0f);
+            vertices.emplace_back(result.xyz(), normalRotated, t1);
 
-        result = rotationMatrix * Vector4(p2, 1.0);
-        vertices.emplace_back(result.xyz(), normalRotated, t2);
+            result = rotationMatrix * Vector4f(p2, 1.0f);
+            vertices.emplace_back(result.xyz(), normalRotated, t2);
 
-        result = rotationMatrix * Vector4(p3, 1.0);
-        vertices.emplace_back(result.xyz(), normalRotated, t3);
+            result = rotationMatrix * Vector4f(p3, 1.0f);
+            vertices.emplace_back(result.xyz(), normalRotated, t3);
 
-        result = rotationMatrix * Vector4(p4, 1.0);
-        vertices.emplace_back(result.xyz(), normalRotated, t4);
-    }
+            result = rotationMatrix * Vector4f(p4, 1.0f);
+            vertices.emplace_back(result.xyz(), normalRotated, t4);
+        }
+    });
 }
\ No newline at end of file
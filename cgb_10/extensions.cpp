@@ -0,0 +1,269 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "extensions.h"
+
+#include <cstdio>
+
+namespace GL
+{
+    template <typename T>
+    static void load(T &function, const char *name, const char *fallback = nullptr)
+    {
+        function = reinterpret_cast<T>(glfwGetProcAddress(name));
+        if (!function && fallback)
+        {
+            function = reinterpret_cast<T>(glfwGetProcAddress(fallback));
+        }
+    }
+
+    static bool isVersion(int requiredMajor, int requiredMinor)
+    {
+        int major = 0, minor = 0;
+        const char *version = reinterpret_cast<const char *>(glGetString(GL_VERSION));
+        if (version) std::sscanf(version, "%d.%d", &major, &minor);
+        return major > requiredMajor || (major == requiredMajor && minor >= requiredMinor);
+    }
+
+    // Checked once in loadExtensions() for functions called every frame or every texture
+    static bool generateMipmapSupported = false;
+    static bool transposeMatrixSupported = false;
+    static bool instancingSupported = false;
+
+    void loadExtensions()
+    {
+        load(GenBuffers, "glGenBuffers", "glGenBuffersARB");
+        load(DeleteBuffers, "glDeleteBuffers", "glDeleteBuffersARB");
+        load(BindBuffer, "glBindBuffer", "glBindBufferARB");
+        load(BufferData, "glBufferData", "glBufferDataARB");
+        load(MapBuffer, "glMapBuffer", "glMapBufferARB");
+        load(UnmapBuffer, "glUnmapBuffer", "glUnmapBufferARB");
+        load(MultTransposeMatrixf, "glMultTransposeMatrixf", "glMultTransposeMatrixfARB");
+        load(ActiveTexture, "glActiveTexture", "glActiveTextureARB");
+        load(ClientActiveTexture, "glClientActiveTexture", "glClientActiveTextureARB");
+        load(MultiTexCoord2fv, "glMultiTexCoord2fv", "glMultiTexCoord2fvARB");
+        load(CompressedTexImage2D, "glCompressedTexImage2D", "glCompressedTexImage2DARB");
+
+        // OpenGL 2.0, the ARB names differ too much for a fallback
+        load(CreateShader, "glCreateShader");
+        load(DeleteShader, "glDeleteShader");
+        load(ShaderSource, "glShaderSource");
+        load(CompileShader, "glCompileShader");
+        load(GetShaderiv, "glGetShaderiv");
+        load(GetShaderInfoLog, "glGetShaderInfoLog");
+        load(CreateProgram, "glCreateProgram");
+        load(DeleteProgram, "glDeleteProgram");
+        load(AttachShader, "glAttachShader");
+        load(LinkProgram, "glLinkProgram");
+        load(GetProgramiv, "glGetProgramiv");
+        load(GetProgramInfoLog, "glGetProgramInfoLog");
+        load(UseProgram, "glUseProgram");
+        load(GetAttribLocation, "glGetAttribLocation");
+        load(GetUniformLocation, "glGetUniformLocation");
+        load(Uniform1i, "glUniform1i");
+        load(Uniform1f, "glUniform1f");
+        load(Uniform2f, "glUniform2f");
+        load(EnableVertexAttribArray, "glEnableVertexAttribArray");
+        load(DisableVertexAttribArray, "glDisableVertexAttribArray");
+        load(VertexAttribPointer, "glVertexAttribPointer");
+
+        load(VertexAttribDivisor, "glVertexAttribDivisor", "glVertexAttribDivisorARB");
+        load(DrawArraysInstanced, "glDrawArraysInstanced", "glDrawArraysInstancedARB");
+        load(DrawElementsInstanced, "glDrawElementsInstanced", "glDrawElementsInstancedARB");
+
+        load(GenFramebuffers, "glGenFramebuffers", "glGenFramebuffersEXT");
+        load(DeleteFramebuffers, "glDeleteFramebuffers", "glDeleteFramebuffersEXT");
+        load(BindFramebuffer, "glBindFramebuffer", "glBindFramebufferEXT");
+        load(CheckFramebufferStatus, "glCheckFramebufferStatus", "glCheckFramebufferStatusEXT");
+        load(FramebufferRenderbuffer, "glFramebufferRenderbuffer", "glFramebufferRenderbufferEXT");
+        load(GenRenderbuffers, "glGenRenderbuffers", "glGenRenderbuffersEXT");
+        load(DeleteRenderbuffers, "glDeleteRenderbuffers", "glDeleteRenderbuffersEXT");
+        load(BindRenderbuffer, "glBindRenderbuffer", "glBindRenderbufferEXT");
+        load(RenderbufferStorage, "glRenderbufferStorage", "glRenderbufferStorageEXT");
+        load(GenerateMipmap, "glGenerateMipmap", "glGenerateMipmapEXT");
+
+        // OpenGL 3.2 or GL_ARB_sync, which uses the same names
+        load(FenceSync, "glFenceSync");
+        load(ClientWaitSync, "glClientWaitSync");
+        load(DeleteSync, "glDeleteSync");
+
+        // OpenGL 3.3 or GL_ARB_timer_query, which uses the same names
+        load(GenQueries, "glGenQueries", "glGenQueriesARB");
+        load(DeleteQueries, "glDeleteQueries", "glDeleteQueriesARB");
+        load(QueryCounter, "glQueryCounter");
+        load(GetQueryObjectiv, "glGetQueryObjectiv", "glGetQueryObjectivARB");
+        load(GetQueryObjectui64v, "glGetQueryObjectui64v", "glGetQueryObjectui64vEXT");
+
+        generateMipmapSupported = GenerateMipmap && (isVersion(3, 0) || glfwExtensionSupported("GL_ARB_framebuffer_object") ||
+                                                     glfwExtensionSupported("GL_EXT_framebuffer_object"));
+        transposeMatrixSupported = MultTransposeMatrixf && (isVersion(1, 3) || glfwExtensionSupported("GL_ARB_transpose_matrix"));
+        instancingSupported = hasVertexBuffers() && hasShaders() && VertexAttribDivisor && DrawArraysInstanced && DrawElementsInstanced &&
+                              (isVersion(3, 3) || glfwExtensionSupported("GL_ARB_instanced_arrays"));
+    }
+
+    /**
+     * Vertex buffer objects as in OpenGL 1.5 or with GL_ARB_vertex_buffer_object.
+     * A loaded function pointer alone does not mean the context supports it.
+     */
+    bool hasVertexBuffers()
+    {
+        if (!GenBuffers || !DeleteBuffers || !BindBuffer || !BufferData) return false;
+        return isVersion(1, 5) || glfwExtensionSupported("GL_ARB_vertex_buffer_object");
+    }
+
+    /**
+     * Shaders as in OpenGL 2.0. Only the core names are loaded, so
+     * GL_ARB_shader_objects alone is not enough.
+     */
+    bool hasShaders()
+    {
+        if (!isVersion(2, 0)) return false;
+        return CreateShader && DeleteShader && ShaderSource && CompileShader && GetShaderiv && GetShaderInfoLog &&
+               CreateProgram && DeleteProgram && AttachShader && LinkProgram && GetProgramiv && GetProgramInfoLog &&
+               UseProgram && GetAttribLocation && GetUniformLocation && Uniform1i &&
+               EnableVertexAttribArray && DisableVertexAttribArray && VertexAttribPointer && ActiveTexture;
+    }
+
+    /**
+     * Shaders in GLSL 1.30 as in OpenGL 3.0, which can read single texels
+     * with texelFetch() and choose the mipmap level in fragment shaders.
+     */
+    bool hasTextureFetch()
+    {
+        return hasShaders() && Uniform1f && Uniform2f && isVersion(3, 0);
+    }
+
+    /**
+     * Instanced drawing as in OpenGL 3.3 or with GL_ARB_instanced_arrays, which
+     * also adds the instanced draw calls. It needs shaders to read the
+     * per-instance attributes.
+     */
+    bool hasInstancing()
+    {
+        return instancingSupported;
+    }
+
+    /**
+     * Texture combiners as in OpenGL 1.3 or with GL_ARB_texture_env_combine,
+     * on at least the given number of texture units.
+     */
+    bool hasTextureCombiners(GLint textureUnits)
+    {
+        if (!ActiveTexture || !ClientActiveTexture || !MultiTexCoord2fv) return false;
+
+        bool combine = isVersion(1, 3) || glfwExtensionSupported("GL_ARB_texture_env_combine");
+
+        GLint availableUnits = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_UNITS, &availableUnits);
+        return combine && availableUnits >= textureUnits;
+    }
+
+    /**
+     * Framebuffer objects as in OpenGL 3.0 or with GL_EXT_framebuffer_object,
+     * needed to render without a window system framebuffer.
+     */
+    bool hasFramebuffers()
+    {
+        if (!GenFramebuffers || !DeleteFramebuffers || !BindFramebuffer || !CheckFramebufferStatus || !FramebufferRenderbuffer ||
+            !GenRenderbuffers || !DeleteRenderbuffers || !BindRenderbuffer || !RenderbufferStorage)
+        {
+            return false;
+        }
+        return isVersion(3, 0) || glfwExtensionSupported("GL_EXT_framebuffer_object");
+    }
+
+    /**
+     * Timestamp queries as in OpenGL 3.3 or with GL_ARB_timer_query, which
+     * unlike elapsed time queries can be nested.
+     */
+    bool hasTimerQueries()
+    {
+        if (!GenQueries || !DeleteQueries || !QueryCounter || !GetQueryObjectiv || !GetQueryObjectui64v) return false;
+        return isVersion(3, 3) || glfwExtensionSupported("GL_ARB_timer_query");
+    }
+
+    /**
+     * glGenerateMipmap as in OpenGL 3.0 or with GL_ARB_framebuffer_object or
+     * GL_EXT_framebuffer_object, otherwise GL_GENERATE_MIPMAP is left to do it.
+     */
+    bool hasGenerateMipmap()
+    {
+        return generateMipmapSupported;
+    }
+
+    /**
+     * Pixel buffer objects as in OpenGL 2.1 or with GL_ARB_pixel_buffer_object,
+     * which let texture uploads read from buffer memory.
+     */
+    bool hasPixelBuffers()
+    {
+        if (!hasVertexBuffers() || !MapBuffer || !UnmapBuffer) return false;
+        return isVersion(2, 1) || glfwExtensionSupported("GL_ARB_pixel_buffer_object");
+    }
+
+    /**
+     * Fences as in OpenGL 3.2 or with GL_ARB_sync, which tell when the commands
+     * issued before them have completed.
+     */
+    bool hasSync()
+    {
+        if (!FenceSync || !ClientWaitSync || !DeleteSync) return false;
+        return isVersion(3, 2) || glfwExtensionSupported("GL_ARB_sync");
+    }
+
+    /**
+     * Block compressed texture formats: BC1 with GL_EXT_texture_compression_s3tc,
+     * BC4 as in OpenGL 3.0 or with GL_ARB_texture_compression_rgtc. BC4 only
+     * has a red channel, so it also needs texture swizzles to be read as gray.
+     */
+    bool hasCompressedFormat(GLenum format)
+    {
+        if (!CompressedTexImage2D) return false;
+        switch (format)
+        {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+                return glfwExtensionSupported("GL_EXT_texture_compression_s3tc");
+            case GL_COMPRESSED_RED_RGTC1:
+                return (isVersion(3, 0) || glfwExtensionSupported("GL_ARB_texture_compression_rgtc")) &&
+                       (isVersion(3, 3) || glfwExtensionSupported("GL_ARB_texture_swizzle") || glfwExtensionSupported("GL_EXT_texture_swizzle"));
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * Multiplies the current OpenGL matrix with the given one.
+     *
+     * The matrix is stored row by row, so with OpenGL 1.3 or
+     * GL_ARB_transpose_matrix it is passed as is, otherwise it is transposed
+     * for glMultMatrixf first.
+     */
+    void multMatrix(const Matrix4f &matrix)
+    {
+        if (transposeMatrixSupported)
+        {
+            MultTransposeMatrixf(matrix.data());
+            return;
+        }
+
+        float columnMajor[16];
+        matrix.toColumnMajor(columnMajor);
+        glMultMatrixf(columnMajor);
+    }
+}
@@ -0,0 +1,254 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#define GLFW_INCLUDE_GLEXT
+
+#include <GLFW/glfw3.h>
+
+#include "cgmath.h"
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#define GL_CALL __stdcall
+#else
+#define GL_CALL
+#endif
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#define GL_STATIC_DRAW 0x88E4
+#endif
+
+#ifndef GL_TEXTURE0
+#define GL_TEXTURE0 0x84C0
+#endif
+
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+
+#ifndef GL_FRAMEBUFFER
+#define GL_DEPTH_COMPONENT24 0x81A6
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#define GL_DEPTH_ATTACHMENT 0x8D00
+#define GL_FRAMEBUFFER 0x8D40
+#define GL_RENDERBUFFER 0x8D41
+#endif
+
+#ifndef GL_TIMESTAMP
+#define GL_QUERY_RESULT 0x8866
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#define GL_TIMESTAMP 0x8E28
+#endif
+
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_WRITE_ONLY 0x88B9
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_STREAM_READ 0x88E1
+#define GL_READ_ONLY 0x88B8
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+
+#ifndef GL_FRAMEBUFFER_BINDING
+#define GL_FRAMEBUFFER_BINDING 0x8CA6
+#endif
+
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_ALREADY_SIGNALED 0x911A
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+#ifndef GL_COMPRESSED_RED_RGTC1
+#define GL_COMPRESSED_RED_RGTC1 0x8DBB
+#endif
+
+#ifndef GL_TEXTURE_SWIZZLE_RGBA
+#define GL_TEXTURE_SWIZZLE_RGBA 0x8E46
+#endif
+
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+
+#ifndef GL_VERTEX_SHADER
+#define GL_FRAGMENT_SHADER 0x8B30
+#define GL_VERTEX_SHADER 0x8B31
+#define GL_COMPILE_STATUS 0x8B81
+#define GL_LINK_STATUS 0x8B82
+#define GL_INFO_LOG_LENGTH 0x8B84
+#endif
+
+/**
+ * OpenGL entry points beyond version 1.1.
+ *
+ * Windows only exports OpenGL 1.1 from opengl32.dll, so everything newer has
+ * to be queried from the driver at runtime. The pointers are loaded once by
+ * loadExtensions() after a context has been made current and stay nullptr if
+ * the driver does not provide the function.
+ */
+namespace GL
+{
+    using GenBuffersProc = void(GL_CALL *)(GLsizei n, GLuint *buffers);
+    using DeleteBuffersProc = void(GL_CALL *)(GLsizei n, const GLuint *buffers);
+    using BindBufferProc = void(GL_CALL *)(GLenum target, GLuint buffer);
+    using BufferDataProc = void(GL_CALL *)(GLenum target, ptrdiff_t size, const void *data, GLenum usage);
+    using MapBufferProc = void *(GL_CALL *)(GLenum target, GLenum access);
+    using UnmapBufferProc = GLboolean(GL_CALL *)(GLenum target);
+    using MultTransposeMatrixfProc = void(GL_CALL *)(const GLfloat *m);
+    using ActiveTextureProc = void(GL_CALL *)(GLenum texture);
+    using ClientActiveTextureProc = void(GL_CALL *)(GLenum texture);
+    using MultiTexCoord2fvProc = void(GL_CALL *)(GLenum target, const GLfloat *v);
+    using CompressedTexImage2DProc = void(GL_CALL *)(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void *data);
+
+    using CreateShaderProc = GLuint(GL_CALL *)(GLenum type);
+    using DeleteShaderProc = void(GL_CALL *)(GLuint shader);
+    using ShaderSourceProc = void(GL_CALL *)(GLuint shader, GLsizei count, const char *const *string, const GLint *length);
+    using CompileShaderProc = void(GL_CALL *)(GLuint shader);
+    using GetShaderivProc = void(GL_CALL *)(GLuint shader, GLenum name, GLint *params);
+    using GetShaderInfoLogProc = void(GL_CALL *)(GLuint shader, GLsizei bufferSize, GLsizei *length, char *infoLog);
+    using CreateProgramProc = GLuint(GL_CALL *)();
+    using DeleteProgramProc = void(GL_CALL *)(GLuint program);
+    using AttachShaderProc = void(GL_CALL *)(GLuint program, GLuint shader);
+    using LinkProgramProc = void(GL_CALL *)(GLuint program);
+    using GetProgramivProc = void(GL_CALL *)(GLuint program, GLenum name, GLint *params);
+    using GetProgramInfoLogProc = void(GL_CALL *)(GLuint program, GLsizei bufferSize, GLsizei *length, char *infoLog);
+    using UseProgramProc = void(GL_CALL *)(GLuint program);
+    using GetAttribLocationProc = GLint(GL_CALL *)(GLuint program, const char *name);
+    using GetUniformLocationProc = GLint(GL_CALL *)(GLuint program, const char *name);
+    using Uniform1iProc = void(GL_CALL *)(GLint location, GLint value);
+    using Uniform1fProc = void(GL_CALL *)(GLint location, GLfloat value);
+    using Uniform2fProc = void(GL_CALL *)(GLint location, GLfloat value0, GLfloat value1);
+    using EnableVertexAttribArrayProc = void(GL_CALL *)(GLuint index);
+    using DisableVertexAttribArrayProc = void(GL_CALL *)(GLuint index);
+    using VertexAttribPointerProc = void(GL_CALL *)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer);
+
+    using VertexAttribDivisorProc = void(GL_CALL *)(GLuint index, GLuint divisor);
+    using DrawArraysInstancedProc = void(GL_CALL *)(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount);
+    using DrawElementsInstancedProc = void(GL_CALL *)(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instanceCount);
+
+    using GenFramebuffersProc = void(GL_CALL *)(GLsizei n, GLuint *framebuffers);
+    using DeleteFramebuffersProc = void(GL_CALL *)(GLsizei n, const GLuint *framebuffers);
+    using BindFramebufferProc = void(GL_CALL *)(GLenum target, GLuint framebuffer);
+    using CheckFramebufferStatusProc = GLenum(GL_CALL *)(GLenum target);
+    using FramebufferRenderbufferProc = void(GL_CALL *)(GLenum target, GLenum attachment, GLenum renderbufferTarget, GLuint renderbuffer);
+    using GenRenderbuffersProc = void(GL_CALL *)(GLsizei n, GLuint *renderbuffers);
+    using DeleteRenderbuffersProc = void(GL_CALL *)(GLsizei n, const GLuint *renderbuffers);
+    using BindRenderbufferProc = void(GL_CALL *)(GLenum target, GLuint renderbuffer);
+    using RenderbufferStorageProc = void(GL_CALL *)(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height);
+
+    using GenerateMipmapProc = void(GL_CALL *)(GLenum target);
+
+    using FenceSyncProc = GLsync(GL_CALL *)(GLenum condition, GLbitfield flags);
+    using ClientWaitSyncProc = GLenum(GL_CALL *)(GLsync sync, GLbitfield flags, uint64_t timeout);
+    using DeleteSyncProc = void(GL_CALL *)(GLsync sync);
+
+    using GenQueriesProc = void(GL_CALL *)(GLsizei n, GLuint *ids);
+    using DeleteQueriesProc = void(GL_CALL *)(GLsizei n, const GLuint *ids);
+    using QueryCounterProc = void(GL_CALL *)(GLuint id, GLenum target);
+    using GetQueryObjectivProc = void(GL_CALL *)(GLuint id, GLenum name, GLint *params);
+    using GetQueryObjectui64vProc = void(GL_CALL *)(GLuint id, GLenum name, uint64_t *params);
+
+    inline GenBuffersProc GenBuffers = nullptr;
+    inline DeleteBuffersProc DeleteBuffers = nullptr;
+    inline BindBufferProc BindBuffer = nullptr;
+    inline BufferDataProc BufferData = nullptr;
+    inline MapBufferProc MapBuffer = nullptr;
+    inline UnmapBufferProc UnmapBuffer = nullptr;
+    inline MultTransposeMatrixfProc MultTransposeMatrixf = nullptr;
+    inline ActiveTextureProc ActiveTexture = nullptr;
+    inline ClientActiveTextureProc ClientActiveTexture = nullptr;
+    inline MultiTexCoord2fvProc MultiTexCoord2fv = nullptr;
+    inline CompressedTexImage2DProc CompressedTexImage2D = nullptr;
+
+    inline CreateShaderProc CreateShader = nullptr;
+    inline DeleteShaderProc DeleteShader = nullptr;
+    inline ShaderSourceProc ShaderSource = nullptr;
+    inline CompileShaderProc CompileShader = nullptr;
+    inline GetShaderivProc GetShaderiv = nullptr;
+    inline GetShaderInfoLogProc GetShaderInfoLog = nullptr;
+    inline CreateProgramProc CreateProgram = nullptr;
+    inline DeleteProgramProc DeleteProgram = nullptr;
+    inline AttachShaderProc AttachShader = nullptr;
+    inline LinkProgramProc LinkProgram = nullptr;
+    inline GetProgramivProc GetProgramiv = nullptr;
+    inline GetProgramInfoLogProc GetProgramInfoLog = nullptr;
+    inline UseProgramProc UseProgram = nullptr;
+    inline GetAttribLocationProc GetAttribLocation = nullptr;
+    inline GetUniformLocationProc GetUniformLocation = nullptr;
+    inline Uniform1iProc Uniform1i = nullptr;
+    inline Uniform1fProc Uniform1f = nullptr;
+    inline Uniform2fProc Uniform2f = nullptr;
+    inline EnableVertexAttribArrayProc EnableVertexAttribArray = nullptr;
+    inline DisableVertexAttribArrayProc DisableVertexAttribArray = nullptr;
+    inline VertexAttribPointerProc VertexAttribPointer = nullptr;
+
+    inline VertexAttribDivisorProc VertexAttribDivisor = nullptr;
+    inline DrawArraysInstancedProc DrawArraysInstanced = nullptr;
+    inline DrawElementsInstancedProc DrawElementsInstanced = nullptr;
+
+    inline GenFramebuffersProc GenFramebuffers = nullptr;
+    inline DeleteFramebuffersProc DeleteFramebuffers = nullptr;
+    inline BindFramebufferProc BindFramebuffer = nullptr;
+    inline CheckFramebufferStatusProc CheckFramebufferStatus = nullptr;
+    inline FramebufferRenderbufferProc FramebufferRenderbuffer = nullptr;
+    inline GenRenderbuffersProc GenRenderbuffers = nullptr;
+    inline DeleteRenderbuffersProc DeleteRenderbuffers = nullptr;
+    inline BindRenderbufferProc BindRenderbuffer = nullptr;
+    inline RenderbufferStorageProc RenderbufferStorage = nullptr;
+
+    inline GenerateMipmapProc GenerateMipmap = nullptr;
+
+    inline FenceSyncProc FenceSync = nullptr;
+    inline ClientWaitSyncProc ClientWaitSync = nullptr;
+    inline DeleteSyncProc DeleteSync = nullptr;
+
+    inline GenQueriesProc GenQueries = nullptr;
+    inline DeleteQueriesProc DeleteQueries = nullptr;
+    inline QueryCounterProc QueryCounter = nullptr;
+    inline GetQueryObjectivProc GetQueryObjectiv = nullptr;
+    inline GetQueryObjectui64vProc GetQueryObjectui64v = nullptr;
+
+    void loadExtensions();
+    bool hasVertexBuffers();
+    bool hasShaders();
+    bool hasTextureFetch();
+    bool hasInstancing();
+    bool hasTextureCombiners(GLint textureUnits);
+    bool hasFramebuffers();
+    bool hasGenerateMipmap();
+    bool hasTimerQueries();
+    bool hasPixelBuffers();
+    bool hasSync();
+    bool hasCompressedFormat(GLenum format);
+    void multMatrix(const Matrix4f &matrix);
+}
@@ -0,0 +1,288 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "geometry.h"
+
+#include "extensions.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+Geometry::Geometry(GLenum primitive)
+    : primitive(primitive)
+{
+}
+
+Geometry::~Geometry()
+{
+    if (vertexBuffer) GL::DeleteBuffers(1, &vertexBuffer);
+    if (indexBuffer) GL::DeleteBuffers(1, &indexBuffer);
+}
+
+/**
+ * Copies the vertices into a vertex buffer object on the GPU.
+ *
+ * Once uploaded, the geometry is drawn with a single glDrawArrays or
+ * glDrawElements call instead of streaming every vertex through glBegin/glEnd
+ * each frame. Indices are stored with 16 bits whenever the vertex count allows.
+ * Geometry shared between several meshes is only uploaded once.
+ *
+ * @param releaseVertices Frees the CPU-side copy after the upload. The geometry
+ *                        can then only be drawn from the vertex buffer.
+ */
+void Geometry::upload(bool releaseVertices)
+{
+    std::span<const Vertex> vertices = getVertices();
+    std::span<const uint32_t> indices = getIndices();
+
+    // The bounds are needed after the vertices may have been released
+    getBounds();
+
+    if (!GL::hasVertexBuffers() || vertices.empty()) return;
+
+    if (!vertexBuffer)
+    {
+        GL::GenBuffers(1, &vertexBuffer);
+        vertexCount = static_cast<GLsizei>(vertices.size());
+
+        GL::BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        GL::BufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        GL::BindBuffer(GL_ARRAY_BUFFER, 0);
+
+        indexCount = static_cast<GLsizei>(indices.size());
+        if (!indices.empty())
+        {
+            GL::GenBuffers(1, &indexBuffer);
+            GL::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+            if (vertices.size() <= 65536)
+            {
+                std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+                indexType = GL_UNSIGNED_SHORT;
+                GL::BufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+            }
+            else
+            {
+                indexType = GL_UNSIGNED_INT;
+                GL::BufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+            }
+            GL::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        }
+    }
+
+    if (releaseVertices)
+    {
+        this->vertices.clear();
+        this->vertices.shrink_to_fit();
+        this->indices.clear();
+        this->indices.shrink_to_fit();
+        mappedFile = nullptr;
+        mappedVertices = {};
+        mappedIndices = {};
+    }
+}
+
+/**
+ * @param textureUnits Number of texture units that receive the texture
+ *                     coordinates, more than one needs multitexturing.
+ */
+void Geometry::draw(GLint textureUnits) const
+{
+    std::span<const Vertex> vertices = getVertices();
+    std::span<const uint32_t> indices = getIndices();
+
+    bool useVertexBuffer = vertexBuffer && (renderMode == RenderMode::VertexBuffer || vertices.empty());
+
+    if (useVertexBuffer)
+    {
+        bindArrays(textureUnits);
+        if (indexBuffer)
+        {
+            glDrawElements(primitive, indexCount, indexType, nullptr);
+        }
+        else
+        {
+            glDrawArrays(primitive, 0, vertexCount);
+        }
+        unbindArrays(textureUnits);
+        return;
+    }
+
+    auto emit = [textureUnits](const Vertex &vertex)
+    {
+        glNormal3fv(vertex.normal);
+        glTexCoord2fv(vertex.texcoord);
+        for (GLint unit = 1; unit < textureUnits; unit++) GL::MultiTexCoord2fv(GL_TEXTURE0 + unit, vertex.texcoord);
+        glVertex3fv(vertex.position);
+    };
+
+    glBegin(primitive);
+    if (indices.empty())
+    {
+        for (const Vertex &vertex : vertices) emit(vertex);
+    }
+    else
+    {
+        for (uint32_t index : indices) emit(vertices[index]);
+    }
+    glEnd();
+}
+
+/**
+ * Draws instanceCount copies of the uploaded geometry in one call. The
+ * caller binds a shader that places the instances, see InstancedMesh.
+ * Needs GL::hasInstancing() and a previous upload().
+ */
+void Geometry::drawInstanced(GLsizei instanceCount) const
+{
+    bindArrays();
+    if (indexBuffer)
+    {
+        GL::DrawElementsInstanced(primitive, indexCount, indexType, nullptr, instanceCount);
+    }
+    else
+    {
+        GL::DrawArraysInstanced(primitive, 0, vertexCount, instanceCount);
+    }
+    unbindArrays();
+}
+
+bool Geometry::isUploaded() const
+{
+    return vertexBuffer != 0;
+}
+
+void Geometry::bindArrays(GLint textureUnits) const
+{
+    GL::BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(Vertex), reinterpret_cast<const void *>(offsetof(Vertex, position)));
+    glNormalPointer(GL_FLOAT, sizeof(Vertex), reinterpret_cast<const void *>(offsetof(Vertex, normal)));
+    for (GLint unit = textureUnits - 1; unit >= 0; unit--)
+    {
+        if (textureUnits > 1) GL::ClientActiveTexture(GL_TEXTURE0 + unit);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), reinterpret_cast<const void *>(offsetof(Vertex, texcoord)));
+    }
+    if (indexBuffer) GL::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+}
+
+void Geometry::unbindArrays(GLint textureUnits) const
+{
+    if (indexBuffer) GL::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    for (GLint unit = textureUnits - 1; unit >= 0; unit--)
+    {
+        if (textureUnits > 1) GL::ClientActiveTexture(GL_TEXTURE0 + unit);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    }
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    GL::BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * Uses vertex and index data that lives in a memory mapped file instead of
+ * the vertex and index lists. The mapping is kept alive as long as this
+ * geometry refers to it.
+ */
+void Geometry::map(const std::shared_ptr<const MappedFile> &file, std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+{
+    mappedFile = file;
+    mappedVertices = vertices;
+    mappedIndices = indices;
+    this->vertices.clear();
+    this->indices.clear();
+}
+
+/**
+ * Reverses the order in which the corners of each primitive are emitted,
+ * turning front faces into back faces.
+ */
+void Geometry::flipWinding()
+{
+    if (!indices.empty())
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            std::swap(indices[i + 1], indices[i + 2]);
+        }
+    }
+    else if (primitive == GL_QUADS)
+    {
+        for (size_t i = 0; i + 3 < vertices.size(); i += 4)
+        {
+            std::reverse(vertices.begin() + i, vertices.begin() + i + 4);
+        }
+    }
+}
+
+std::span<const Vertex> Geometry::getVertices() const
+{
+    return mappedFile ? mappedVertices : std::span<const Vertex>(vertices);
+}
+
+std::span<const uint32_t> Geometry::getIndices() const
+{
+    return mappedFile ? mappedIndices : std::span<const uint32_t>(indices);
+}
+
+/**
+ * Returns the bounding sphere of the vertices. It is computed on first use
+ * and kept when the vertices are released by upload().
+ */
+const Bounds &Geometry::getBounds() const
+{
+    if (boundsValid) return bounds;
+
+    std::span<const Vertex> vertices = getVertices();
+    if (vertices.empty()) return bounds;
+
+    Vector3f min = {vertices[0].position[0], vertices[0].position[1], vertices[0].position[2]};
+    Vector3f max = min;
+    for (const Vertex &vertex : vertices)
+    {
+        min = {std::min(min.x, vertex.position[0]), std::min(min.y, vertex.position[1]), std::min(min.z, vertex.position[2])};
+        max = {std::max(max.x, vertex.position[0]), std::max(max.y, vertex.position[1]), std::max(max.z, vertex.position[2])};
+    }
+
+    Vector3f center = {(min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f};
+    float radiusSquared = 0.0f;
+    for (const Vertex &vertex : vertices)
+    {
+        float dx = vertex.position[0] - center.x;
+        float dy = vertex.position[1] - center.y;
+        float dz = vertex.position[2] - center.z;
+        radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+    }
+
+    bounds = {center, std::sqrt(radiusSquared)};
+    boundsValid = true;
+    return bounds;
+}
+
+void Geometry::setRenderMode(RenderMode mode)
+{
+    renderMode = mode;
+}
+
+RenderMode Geometry::getRenderMode()
+{
+    return renderMode;
+}
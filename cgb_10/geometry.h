@@ -0,0 +1,89 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#define GLFW_INCLUDE_GLEXT
+
+#include "cgmath.h"
+#include "mappedfile.h"
+
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+enum class RenderMode
+{
+    Immediate,
+    VertexBuffer
+};
+
+/**
+ * Enclosing sphere of a set of vertices, centered on their bounding box.
+ */
+struct Bounds
+{
+    Vector3f center;
+    float radius;
+};
+
+/**
+ * Vertex and index data of a mesh together with its copy on the GPU.
+ */
+class Geometry
+{
+  public:
+    Geometry(GLenum primitive = GL_QUADS);
+    Geometry(const Geometry &) = delete;
+    Geometry &operator=(const Geometry &) = delete;
+    ~Geometry();
+    void upload(bool releaseVertices = false);
+    void draw(GLint textureUnits = 1) const;
+    void drawInstanced(GLsizei instanceCount) const;
+    bool isUploaded() const;
+    void map(const std::shared_ptr<const MappedFile> &file, std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+    void flipWinding();
+    std::span<const Vertex> getVertices() const;
+    std::span<const uint32_t> getIndices() const;
+    const Bounds &getBounds() const;
+    static void setRenderMode(RenderMode mode);
+    static RenderMode getRenderMode();
+
+    GLenum primitive = GL_QUADS;
+    std::vector<Vertex> vertices = {};
+    std::vector<uint32_t> indices = {};
+
+  private:
+    void bindArrays(GLint textureUnits = 1) const;
+    void unbindArrays(GLint textureUnits = 1) const;
+
+    std::shared_ptr<const MappedFile> mappedFile = nullptr;
+    std::span<const Vertex> mappedVertices = {};
+    std::span<const uint32_t> mappedIndices = {};
+    GLuint vertexBuffer = 0;
+    GLuint indexBuffer = 0;
+    GLsizei vertexCount = 0;
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    mutable Bounds bounds = {};
+    mutable bool boundsValid = false;
+    static inline RenderMode renderMode = RenderMode::VertexBuffer;
+};
@@ -0,0 +1,271 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "geometrycache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    const char cacheMagic[8] = {'C', 'G', 'B', 'G', 'E', 'O', 0, 0};
+
+    /**
+     * Increase whenever the generators or the file layout change, older cache
+     * files are then ignored and rebuilt.
+     */
+    const uint32_t cacheVersion = 1;
+
+    struct CacheHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t vertexSize;
+        uint32_t entryCount;
+        uint32_t reserved;
+    };
+
+    struct CacheEntry
+    {
+        uint32_t shape;
+        int32_t segments;
+        uint32_t winding;
+        uint32_t primitive;
+        uint64_t vertexOffset;
+        uint64_t vertexCount;
+        uint64_t indexOffset;
+        uint64_t indexCount;
+    };
+
+    /**
+     * Checks that an entry only names known shapes and primitives and that its
+     * arrays lie aligned within a file of the given size. The mapping itself
+     * starts on a page boundary.
+     */
+    bool isValid(const CacheEntry &entry, size_t size)
+    {
+        if (entry.shape > static_cast<uint32_t>(Shape::Skybox) || entry.winding > static_cast<uint32_t>(Winding::Clockwise)) return false;
+        if (entry.primitive != GL_QUADS && entry.primitive != GL_TRIANGLES) return false;
+
+        if (entry.vertexOffset % alignof(Vertex) != 0 || entry.indexOffset % alignof(uint32_t) != 0) return false;
+        if (entry.vertexOffset > size || entry.vertexCount > (size - entry.vertexOffset) / sizeof(Vertex)) return false;
+        if (entry.indexOffset > size || entry.indexCount > (size - entry.indexOffset) / sizeof(uint32_t)) return false;
+        return true;
+    }
+}
+
+/**
+ * Returns the geometry for the given key. If no mesh holds it yet, it is taken
+ * from the mapped cache file or created with the generator.
+ *
+ * @param key The shape parameters.
+ * @param generate Fills an empty geometry with counter-clockwise primitives.
+ * @return The shared geometry.
+ */
+std::shared_ptr<Geometry> GeometryCache::get(const GeometryKey &key, const std::function<void(Geometry &)> &generate)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (std::shared_ptr<Geometry> geometry = entries[key].lock())
+    {
+        return geometry;
+    }
+
+    auto geometry = std::make_shared<Geometry>();
+
+    auto mapped = mappedEntries.find(key);
+    if (mapped != mappedEntries.end())
+    {
+        geometry->primitive = mapped->second.primitive;
+        geometry->map(file, mapped->second.vertices, mapped->second.indices);
+        mappedCount++;
+    }
+    else
+    {
+        generate(*geometry);
+        if (key.winding == Winding::Clockwise) geometry->flipWinding();
+        generatedCount++;
+        modified = true;
+    }
+
+    entries[key] = geometry;
+    return geometry;
+}
+
+/**
+ * Maps a cache file written by save(). Missing, outdated or damaged files are
+ * ignored.
+ *
+ * @return True if the file was mapped.
+ */
+bool GeometryCache::load(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!std::filesystem::exists(filename)) return false;
+
+    std::shared_ptr<const MappedFile> mappedFile;
+    try
+    {
+        mappedFile = std::make_shared<const MappedFile>(filename);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+
+    const uint8_t *data = mappedFile->data();
+    size_t size = mappedFile->size();
+
+    CacheHeader header;
+    if (size < sizeof(header)) return false;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion || header.vertexSize != sizeof(Vertex))
+    {
+        return false;
+    }
+    if (size < sizeof(header) + header.entryCount * sizeof(CacheEntry)) return false;
+
+    std::map<GeometryKey, MappedEntry> loaded;
+    for (uint32_t i = 0; i < header.entryCount; i++)
+    {
+        CacheEntry entry;
+        std::memcpy(&entry, data + sizeof(header) + i * sizeof(CacheEntry), sizeof(entry));
+
+        if (!isValid(entry, size)) return false;
+
+        const uint32_t *indices = reinterpret_cast<const uint32_t *>(data + entry.indexOffset);
+        for (uint64_t j = 0; j < entry.indexCount; j++)
+        {
+            if (indices[j] >= entry.vertexCount) return false;
+        }
+
+        GeometryKey key = {static_cast<Shape>(entry.shape), entry.segments, static_cast<Winding>(entry.winding)};
+        loaded[key] = {
+            static_cast<GLenum>(entry.primitive),
+            std::span<const Vertex>(reinterpret_cast<const Vertex *>(data + entry.vertexOffset), entry.vertexCount),
+            std::span<const uint32_t>(indices, entry.indexCount)};
+    }
+
+    file = mappedFile;
+    mappedEntries = std::move(loaded);
+    return true;
+}
+
+/**
+ * Writes all geometry that is still alive and still has its CPU-side data to
+ * the cache file. Does nothing if nothing was generated since load().
+ *
+ * The file is written under a temporary name and moved into place, so a
+ * mapping of the previous version stays valid. On Windows the mapped file is
+ * moved aside first, and removed here or by a later save() once unmapped.
+ *
+ * @return True if the file is up to date.
+ */
+bool GeometryCache::save(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!modified) return true;
+
+    std::vector<std::pair<GeometryKey, std::shared_ptr<Geometry>>> alive;
+    for (const auto &[key, weak] : entries)
+    {
+        std::shared_ptr<Geometry> geometry = weak.lock();
+        if (geometry && !geometry->getVertices().empty()) alive.emplace_back(key, geometry);
+    }
+
+    CacheHeader header = {};
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.vertexSize = sizeof(Vertex);
+    header.entryCount = static_cast<uint32_t>(alive.size());
+
+    std::vector<CacheEntry> table;
+    uint64_t offset = sizeof(header) + alive.size() * sizeof(CacheEntry);
+    for (const auto &[key, geometry] : alive)
+    {
+        CacheEntry entry = {};
+        entry.shape = static_cast<uint32_t>(key.shape);
+        entry.segments = key.segments;
+        entry.winding = static_cast<uint32_t>(key.winding);
+        entry.primitive = geometry->primitive;
+        entry.vertexOffset = offset;
+        entry.vertexCount = geometry->getVertices().size();
+        offset += entry.vertexCount * sizeof(Vertex);
+        entry.indexOffset = offset;
+        entry.indexCount = geometry->getIndices().size();
+        offset += entry.indexCount * sizeof(uint32_t);
+        table.push_back(entry);
+    }
+
+    std::string temporary = filename + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(CacheEntry));
+        for (const auto &[key, geometry] : alive)
+        {
+            std::span<const Vertex> vertices = geometry->getVertices();
+            std::span<const uint32_t> indices = geometry->getIndices();
+            out.write(reinterpret_cast<const char *>(vertices.data()), vertices.size_bytes());
+            out.write(reinterpret_cast<const char *>(indices.data()), indices.size_bytes());
+        }
+        if (!out) return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, filename, error);
+#if defined(_WIN32)
+    // Windows cannot replace a file that is still mapped, but can move it aside since it was opened with FILE_SHARE_DELETE
+    if (error)
+    {
+        std::string previous = filename + ".old";
+        std::filesystem::remove(previous, error);
+        std::filesystem::rename(filename, previous, error);
+        if (!error) std::filesystem::rename(temporary, filename, error);
+        std::error_code ignored;
+        std::filesystem::remove(previous, ignored);
+    }
+#endif
+    if (error)
+    {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    modified = false;
+    return true;
+}
+
+size_t GeometryCache::getGeneratedCount()
+{
+    return generatedCount;
+}
+
+size_t GeometryCache::getMappedCount()
+{
+    return mappedCount;
+}
@@ -0,0 +1,90 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "geometry.h"
+#include "mappedfile.h"
+
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+enum class Shape : uint32_t
+{
+    Sphere,
+    Cube,
+    Skybox
+};
+
+enum class Winding : uint32_t
+{
+    CounterClockwise,
+    Clockwise
+};
+
+/**
+ * The parameters a generated geometry depends on.
+ */
+struct GeometryKey
+{
+    Shape shape;
+    int32_t segments;
+    Winding winding;
+
+    auto operator<=>(const GeometryKey &) const = default;
+};
+
+/**
+ * Registry that hands out one shared Geometry per set of generator
+ * parameters, so meshes of the same shape share vertex data and GPU buffers.
+ *
+ * Generated geometry can be written to a versioned binary cache file. After
+ * load() the file is memory mapped and geometry found in it is used straight
+ * from the mapping instead of being generated again.
+ */
+class GeometryCache
+{
+  public:
+    static std::shared_ptr<Geometry> get(const GeometryKey &key, const std::function<void(Geometry &)> &generate);
+    static bool load(const std::string &filename);
+    static bool save(const std::string &filename);
+    static size_t getGeneratedCount();
+    static size_t getMappedCount();
+
+  private:
+    struct MappedEntry
+    {
+        GLenum primitive;
+        std::span<const Vertex> vertices;
+        std::span<const uint32_t> indices;
+    };
+
+    static inline std::mutex mutex;
+    static inline std::map<GeometryKey, std::weak_ptr<Geometry>> entries;
+    static inline std::map<GeometryKey, MappedEntry> mappedEntries;
+    static inline std::shared_ptr<const MappedFile> file = nullptr;
+    static inline size_t generatedCount = 0;
+    static inline size_t mappedCount = 0;
+    static inline bool modified = false;
+};
@@ -0,0 +1,176 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "inputrecording.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    const char recordingMagic[8] = {'C', 'G', 'B', 'I', 'N', 'P', 0, 0};
+
+    /**
+     * Increase whenever the file layout changes, older recordings are then
+     * rejected.
+     */
+    const uint32_t recordingVersion = 1;
+
+    struct RecordingHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t eventSize;
+        uint32_t frameCount;
+        uint32_t eventCount;
+        double cursorX;
+        double cursorY;
+    };
+
+    struct FrameRecord
+    {
+        double time;
+        uint32_t eventCount;
+        uint32_t reserved;
+    };
+}
+
+/**
+ * Starts an empty recording.
+ *
+ * @param cursorX The cursor position the camera was set up with before the first frame.
+ * @param cursorY See cursorX.
+ */
+InputRecording::InputRecording(double cursorX, double cursorY)
+    : cursorX(cursorX), cursorY(cursorY)
+{
+}
+
+/**
+ * Loads a recording written by save().
+ */
+InputRecording::InputRecording(const std::string &filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+    {
+        throw std::runtime_error("Failed to open input recording: " + filename);
+    }
+
+    RecordingHeader header;
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, recordingMagic, sizeof(recordingMagic)) != 0 || header.version != recordingVersion ||
+        header.eventSize != sizeof(InputEvent))
+    {
+        throw std::runtime_error("Not a compatible input recording: " + filename);
+    }
+    cursorX = header.cursorX;
+    cursorY = header.cursorY;
+
+    std::vector<FrameRecord> records(header.frameCount);
+    events.resize(header.eventCount);
+    in.read(reinterpret_cast<char *>(records.data()), records.size() * sizeof(FrameRecord));
+    in.read(reinterpret_cast<char *>(events.data()), events.size() * sizeof(InputEvent));
+    if (!in)
+    {
+        throw std::runtime_error("Input recording is truncated: " + filename);
+    }
+
+    uint64_t firstEvent = 0;
+    frames.reserve(records.size());
+    for (const FrameRecord &record : records)
+    {
+        if (firstEvent + record.eventCount > events.size())
+        {
+            throw std::runtime_error("Input recording is corrupt: " + filename);
+        }
+        frames.push_back({record.time, static_cast<uint32_t>(firstEvent), record.eventCount});
+        firstEvent += record.eventCount;
+    }
+}
+
+void InputRecording::save(const std::string &filename) const
+{
+    RecordingHeader header = {};
+    std::memcpy(header.magic, recordingMagic, sizeof(recordingMagic));
+    header.version = recordingVersion;
+    header.eventSize = sizeof(InputEvent);
+    header.frameCount = static_cast<uint32_t>(frames.size());
+    header.eventCount = static_cast<uint32_t>(events.size());
+    header.cursorX = cursorX;
+    header.cursorY = cursorY;
+
+    std::vector<FrameRecord> records;
+    records.reserve(frames.size());
+    for (const Frame &frame : frames)
+    {
+        records.push_back({frame.time, frame.eventCount, 0});
+    }
+
+    std::ofstream out(filename, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(FrameRecord));
+    out.write(reinterpret_cast<const char *>(events.data()), events.size() * sizeof(InputEvent));
+    if (!out)
+    {
+        throw std::runtime_error("Failed to write input recording: " + filename);
+    }
+}
+
+/**
+ * Starts the next frame, whose simulation runs at the given time. Events
+ * added afterwards belong to this frame.
+ */
+void InputRecording::beginFrame(double time)
+{
+    frames.push_back({time, static_cast<uint32_t>(events.size()), 0});
+}
+
+void InputRecording::addEvent(const InputEvent &event)
+{
+    if (frames.empty()) beginFrame(0.0);
+    events.push_back(event);
+    frames.back().eventCount++;
+}
+
+size_t InputRecording::getFrameCount() const
+{
+    return frames.size();
+}
+
+double InputRecording::getTime(size_t frame) const
+{
+    return frames.at(frame).time;
+}
+
+std::span<const InputEvent> InputRecording::getEvents(size_t frame) const
+{
+    const Frame &record = frames.at(frame);
+    return std::span<const InputEvent>(events).subspan(record.firstEvent, record.eventCount);
+}
+
+double InputRecording::getCursorX() const
+{
+    return cursorX;
+}
+
+double InputRecording::getCursorY() const
+{
+    return cursorY;
+}
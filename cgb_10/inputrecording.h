@@ -0,0 +1,80 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+enum class InputType : uint8_t
+{
+    CursorPosition,
+    Scroll,
+    Key
+};
+
+/**
+ * One input callback of GLFW. Cursor positions use x and y, scrolling uses
+ * y, keys use key, action and mods.
+ */
+struct InputEvent
+{
+    InputType type;
+    uint8_t action;
+    uint16_t mods;
+    int32_t key;
+    double x;
+    double y;
+};
+
+/**
+ * The input events and the simulation time of every frame of a session,
+ * so the session can be replayed frame by frame with the same result.
+ *
+ * Saved as a versioned binary file: a header, one record per frame and one
+ * record per event, in native byte order.
+ */
+class InputRecording
+{
+  public:
+    InputRecording(double cursorX, double cursorY);
+    InputRecording(const std::string &filename);
+    void save(const std::string &filename) const;
+    void beginFrame(double time);
+    void addEvent(const InputEvent &event);
+    size_t getFrameCount() const;
+    double getTime(size_t frame) const;
+    std::span<const InputEvent> getEvents(size_t frame) const;
+    double getCursorX() const;
+    double getCursorY() const;
+
+  private:
+    struct Frame
+    {
+        double time;
+        uint32_t firstEvent;
+        uint32_t eventCount;
+    };
+
+    double cursorX = 0.0;
+    double cursorY = 0.0;
+    std::vector<Frame> frames;
+    std::vector<InputEvent> events;
+};
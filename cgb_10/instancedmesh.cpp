@@ -0,0 +1,279 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "instancedmesh.h"
+
+#include "extensions.h"
+#include "renderstate.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+// Lights like the fixed-function pipeline with the scene light GL_LIGHT1,
+// but takes the transform and the emission of each copy from its attributes.
+static const char *vertexSource = R"(
+#version 120
+
+attribute vec4 instanceRow0;
+attribute vec4 instanceRow1;
+attribute vec4 instanceRow2;
+attribute vec4 instanceEmission;
+
+varying vec4 color;
+
+void main()
+{
+    vec4 position = vec4(dot(instanceRow0, gl_Vertex), dot(instanceRow1, gl_Vertex), dot(instanceRow2, gl_Vertex), 1.0);
+    vec3 normal = vec3(dot(instanceRow0.xyz, gl_Normal), dot(instanceRow1.xyz, gl_Normal), dot(instanceRow2.xyz, gl_Normal));
+    normal = normalize(gl_NormalMatrix * normal);
+
+    vec4 eyePosition = gl_ModelViewMatrix * position;
+    vec3 lightDirection = normalize(gl_LightSource[1].position.xyz - eyePosition.xyz * gl_LightSource[1].position.w);
+    float diffuse = max(dot(normal, lightDirection), 0.0);
+
+    color = instanceEmission + gl_FrontLightProduct[1].ambient + gl_FrontLightProduct[1].diffuse * diffuse;
+    color.a = 1.0;
+
+    gl_TexCoord[0] = gl_MultiTexCoord0;
+    gl_Position = gl_ModelViewProjectionMatrix * position;
+}
+)";
+
+static const char *fragmentSource = R"(
+#version 120
+
+uniform sampler2D diffuseTexture;
+uniform bool textured;
+
+varying vec4 color;
+
+void main()
+{
+    gl_FragColor = textured ? color * texture2D(diffuseTexture, gl_TexCoord[0].st) : color;
+}
+)";
+
+InstancedMesh::InstancedMesh(std::shared_ptr<Texture> &texture, const std::shared_ptr<Geometry> &geometry)
+    : Mesh(texture)
+{
+    this->geometry = geometry;
+}
+
+InstancedMesh::~InstancedMesh()
+{
+    if (instanceBuffer) GL::DeleteBuffers(1, &instanceBuffer);
+}
+
+/**
+ * The shader is shared by all instanced meshes and compiled on first use. It
+ * is never deleted, because the context is already gone at static destruction.
+ */
+const Shader &InstancedMesh::getShader()
+{
+    static const Shader *shader = new Shader(vertexSource, fragmentSource);
+    return *shader;
+}
+
+void InstancedMesh::render(const Matrix4f &worldMatrix) const
+{
+    TRACE_ZONE("InstancedMesh::render");
+    if (instances.empty()) return;
+
+    RenderState::bindTexture(texture ? texture->id : 0);
+    RenderState::setMaterial(GL_AMBIENT, ambient);
+    RenderState::setMaterial(GL_DIFFUSE, diffuse);
+    RenderState::setMaterial(GL_SPECULAR, specular);
+    RenderState::setShininess(shininess);
+    applyBlendMode();
+
+    if (GL::hasInstancing() && geometry->isUploaded() && Geometry::getRenderMode() == RenderMode::VertexBuffer)
+    {
+        renderInstanced(worldMatrix);
+    }
+    else
+    {
+        renderEach(worldMatrix);
+    }
+}
+
+void InstancedMesh::renderInstanced(const Matrix4f &worldMatrix) const
+{
+    if (!instanceBuffer) GL::GenBuffers(1, &instanceBuffer);
+
+    GL::BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    if (instancesChanged)
+    {
+        GL::BufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STREAM_DRAW);
+        instancesChanged = false;
+    }
+
+    const Shader &shader = getShader();
+    shader.use();
+    GL::Uniform1i(shader.getUniform("diffuseTexture"), 0);
+    GL::Uniform1i(shader.getUniform("textured"), texture ? 1 : 0);
+
+    const char *names[4] = {"instanceRow0", "instanceRow1", "instanceRow2", "instanceEmission"};
+    const size_t offsets[4] = {offsetof(Instance, transform), offsetof(Instance, transform) + 4 * sizeof(float),
+                               offsetof(Instance, transform) + 8 * sizeof(float), offsetof(Instance, emission)};
+    GLint locations[4];
+    for (int i = 0; i < 4; i++)
+    {
+        locations[i] = shader.getAttribute(names[i]);
+        if (locations[i] < 0) continue;
+        GL::EnableVertexAttribArray(locations[i]);
+        GL::VertexAttribPointer(locations[i], 4, GL_FLOAT, GL_FALSE, sizeof(Instance), reinterpret_cast<const void *>(offsets[i]));
+        GL::VertexAttribDivisor(locations[i], 1);
+    }
+    GL::BindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glPushMatrix();
+    GL::multMatrix(worldMatrix);
+    geometry->drawInstanced(static_cast<GLsizei>(instances.size()));
+    glPopMatrix();
+
+    for (GLint location : locations)
+    {
+        if (location < 0) continue;
+        GL::VertexAttribDivisor(location, 0);
+        GL::DisableVertexAttribArray(location);
+    }
+    Shader::useFixedFunction();
+}
+
+void InstancedMesh::renderEach(const Matrix4f &worldMatrix) const
+{
+    glPushMatrix();
+    GL::multMatrix(worldMatrix);
+    for (const Instance &instance : instances)
+    {
+        const float *t = instance.transform;
+        Matrix4f transform = {
+            t[0], t[1], t[2],  t[3],
+            t[4], t[5], t[6],  t[7],
+            t[8], t[9], t[10], t[11],
+               0,    0,     0,     1
+        };
+        glPushMatrix();
+        GL::multMatrix(transform);
+        RenderState::setMaterial(GL_EMISSION, instance.emission);
+        geometry->draw();
+        glPopMatrix();
+    }
+    glPopMatrix();
+}
+
+/**
+ * Returns a sphere that encloses all instances, relative to the node. Unless
+ * set with setBounds(), it is computed from the instances on first use.
+ */
+const Bounds &InstancedMesh::getBounds() const
+{
+    if (boundsValid) return bounds;
+
+    const Bounds &local = geometry->getBounds();
+    Vector3f min = {INFINITY, INFINITY, INFINITY};
+    Vector3f max = {-INFINITY, -INFINITY, -INFINITY};
+    std::vector<Vector4f> spheres;
+    spheres.reserve(instances.size());
+    for (const Instance &instance : instances)
+    {
+        const float *t = instance.transform;
+        Vector3f c = local.center;
+        Vector3f center = {t[0] * c.x + t[1] * c.y + t[2] * c.z + t[3],
+                           t[4] * c.x + t[5] * c.y + t[6] * c.z + t[7],
+                           t[8] * c.x + t[9] * c.y + t[10] * c.z + t[11]};
+        float scale = std::sqrt(std::max({t[0] * t[0] + t[4] * t[4] + t[8] * t[8],
+                                          t[1] * t[1] + t[5] * t[5] + t[9] * t[9],
+                                          t[2] * t[2] + t[6] * t[6] + t[10] * t[10]}));
+        float radius = local.radius * scale;
+        spheres.emplace_back(center, radius);
+        min = {std::min(min.x, center.x - radius), std::min(min.y, center.y - radius), std::min(min.z, center.z - radius)};
+        max = {std::max(max.x, center.x + radius), std::max(max.y, center.y + radius), std::max(max.z, center.z + radius)};
+    }
+
+    bounds = {};
+    if (!spheres.empty())
+    {
+        Vector3f center = {(min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f};
+        float radius = 0.0f;
+        for (const Vector4f &sphere : spheres)
+        {
+            float dx = sphere.x - center.x;
+            float dy = sphere.y - center.y;
+            float dz = sphere.z - center.z;
+            radius = std::max(radius, std::sqrt(dx * dx + dy * dy + dz * dz) + sphere.w);
+        }
+        bounds = {center, radius};
+    }
+    boundsValid = true;
+    return bounds;
+}
+
+/**
+ * Fixes the bounds of the instances, e.g. to a shell that all orbits stay
+ * within, so editInstances() does not have to recompute them.
+ */
+void InstancedMesh::setBounds(const Bounds &bounds)
+{
+    this->bounds = bounds;
+    boundsValid = true;
+    invalidate();
+}
+
+/**
+ * Resizes the instances, which also recomputes the bounds.
+ */
+void InstancedMesh::setInstanceCount(size_t count)
+{
+    instances.resize(count, Instance{{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0}, {0, 0, 0, 1}});
+    instancesChanged = true;
+    boundsValid = false;
+    invalidate();
+}
+
+/**
+ * Changes a single instance, which also recomputes the bounds.
+ */
+void InstancedMesh::setInstance(size_t index, const Matrix4f &transform, const Colorf &emission)
+{
+    Instance &instance = instances[index];
+    std::copy(transform.data(), transform.data() + 12, instance.transform);
+    std::copy(&emission.r, &emission.r + 4, instance.emission);
+    instancesChanged = true;
+    boundsValid = false;
+    invalidate();
+}
+
+/**
+ * Gives write access to all instances and schedules their upload with the
+ * next render(). The bounds stay as they are, callers that move instances
+ * beyond them call setBounds() as well.
+ */
+std::span<Instance> InstancedMesh::editInstances()
+{
+    instancesChanged = true;
+    return instances;
+}
+
+size_t InstancedMesh::getInstanceCount() const
+{
+    return instances.size();
+}
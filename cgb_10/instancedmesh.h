@@ -0,0 +1,70 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mesh.h"
+#include "shader.h"
+
+#include <memory>
+#include <span>
+#include <vector>
+
+/**
+ * Per-instance data: the first three rows of the transform relative to the
+ * node of the mesh and the emission color, which replaces the emission of
+ * the material.
+ */
+struct Instance
+{
+    float transform[12];
+    float emission[4];
+};
+
+/**
+ * Draws many copies of one geometry with a single instanced draw call.
+ *
+ * The instance data is written to one buffer per frame at most, and only if
+ * it changed. Without instancing support or in immediate mode, the instances
+ * are drawn one after another instead.
+ */
+class InstancedMesh : public Mesh
+{
+  public:
+    InstancedMesh(std::shared_ptr<Texture> &texture, const std::shared_ptr<Geometry> &geometry);
+    ~InstancedMesh();
+    void render(const Matrix4f &worldMatrix) const override;
+    const Bounds &getBounds() const override;
+    void setBounds(const Bounds &bounds);
+    void setInstanceCount(size_t count);
+    void setInstance(size_t index, const Matrix4f &transform, const Colorf &emission);
+    std::span<Instance> editInstances();
+    size_t getInstanceCount() const;
+
+  private:
+    void renderInstanced(const Matrix4f &worldMatrix) const;
+    void renderEach(const Matrix4f &worldMatrix) const;
+    static const Shader &getShader();
+
+    std::vector<Instance> instances;
+    mutable GLuint instanceBuffer = 0;
+    mutable bool instancesChanged = true;
+    mutable Bounds bounds = {};
+    mutable bool boundsValid = false;
+};
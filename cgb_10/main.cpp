@@ -17,16 +17,183 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include "profiler.h"
 #include "renderer.h"
+#include "sphere.h"
+#include "trace.h"
 
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
-int main()
+static void printUsage(const char *program)
 {
+    std::cerr << "Usage: " << program << " --sphere-report | --sphere-benchmark | --math-benchmark" << std::endl;
+    std::cerr << "       " << program << " [--instancing-benchmark | --compare-planet] [options]" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --headless             render offscreen" << std::endl;
+    std::cerr << "  --frames <count>       stop after the given number of frames" << std::endl;
+    std::cerr << "  --simulation-rate <hz> step the simulation at this rate, 120 by default" << std::endl;
+    std::cerr << "  --dump <directory>     write every frame as an image" << std::endl;
+    std::cerr << "  --profile <file>       write the frame profile" << std::endl;
+    std::cerr << "  --trace <file>         write Chrome trace events" << std::endl;
+    std::cerr << "  --record <file>        record input and the simulation clock" << std::endl;
+    std::cerr << "  --replay <file>        replay a recording" << std::endl;
+}
+
+static uint32_t parseFrameCount(const std::string &text)
+{
+    size_t length = 0;
+    unsigned long count = 0;
+    try
+    {
+        count = std::stoul(text, &length);
+    }
+    catch (const std::exception &)
+    {
+        length = 0;
+    }
+    if (length == 0 || length != text.size() || text[0] == '-' || count > UINT32_MAX)
+    {
+        throw std::runtime_error("Invalid frame count: " + text);
+    }
+    return static_cast<uint32_t>(count);
+}
+
+static double parseSimulationRate(const std::string &text)
+{
+    size_t length = 0;
+    double rate = 0.0;
     try
     {
-        Renderer renderer("Grundlagen der Computergrafik", 1280, 720);
-        renderer.start();
+        rate = std::stod(text, &length);
+    }
+    catch (const std::exception &)
+    {
+        length = 0;
+    }
+    if (length == 0 || length != text.size() || !std::isfinite(rate) || rate <= 0.0)
+    {
+        throw std::runtime_error("Invalid simulation rate: " + text);
+    }
+    return rate;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && std::string(argv[1]) == "--sphere-report")
+    {
+        Sphere::printReport();
+        return EXIT_SUCCESS;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--sphere-benchmark")
+    {
+        Sphere::printBenchmark();
+        return EXIT_SUCCESS;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--math-benchmark")
+    {
+        if (!Math::verify()) return EXIT_FAILURE;
+        Math::printBenchmark();
+        return EXIT_SUCCESS;
+    }
+
+    // --headless renders offscreen, e.g. on a build server, and combines with the modes below
+    std::string mode;
+    bool headless = false;
+    uint32_t frames = 0;
+    double simulationRate = 0.0;
+    std::string dumpDirectory;
+    std::string profileFile;
+    std::string traceFile;
+    std::string recordFile;
+    std::string replayFile;
+
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string argument = argv[i];
+            if (argument == "--headless")
+            {
+                headless = true;
+            }
+            else if (argument == "--frames" && i + 1 < argc)
+            {
+                frames = parseFrameCount(argv[++i]);
+            }
+            else if (argument == "--simulation-rate" && i + 1 < argc)
+            {
+                simulationRate = parseSimulationRate(argv[++i]);
+            }
+            else if (argument == "--dump" && i + 1 < argc)
+            {
+                dumpDirectory = argv[++i];
+            }
+            else if (argument == "--profile" && i + 1 < argc)
+            {
+                profileFile = argv[++i];
+            }
+            else if (argument == "--trace" && i + 1 < argc)
+            {
+                traceFile = argv[++i];
+            }
+            else if (argument == "--record" && i + 1 < argc)
+            {
+                recordFile = argv[++i];
+            }
+            else if (argument == "--replay" && i + 1 < argc)
+            {
+                replayFile = argv[++i];
+            }
+            else if (mode.empty() && (argument == "--instancing-benchmark" || argument == "--compare-planet"))
+            {
+                mode = argument;
+            }
+            else
+            {
+                std::cerr << "Unknown or incomplete argument: " << argument << std::endl;
+                printUsage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (!traceFile.empty() && !Trace::enabled)
+        {
+            std::cerr << "Tracing is not compiled in, build with make TRACE=1" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        Renderer renderer("Grundlagen der Computergrafik", 1280, 720, headless);
+        if (!recordFile.empty()) renderer.record(recordFile);
+        if (!replayFile.empty()) renderer.replay(replayFile);
+        if (simulationRate > 0.0) renderer.setSimulationRate(simulationRate);
+        if (mode == "--instancing-benchmark")
+        {
+            renderer.benchmarkInstancing();
+        }
+        else if (mode == "--compare-planet")
+        {
+            if (!renderer.comparePlanetShading()) return EXIT_FAILURE;
+        }
+        else
+        {
+            // Headless runs without a recording to replay stop after a default number of frames
+            if (headless && frames == 0 && replayFile.empty()) frames = 300;
+            renderer.start(frames, dumpDirectory);
+        }
+
+        if (!profileFile.empty())
+        {
+            Profiler::printReport(std::cout);
+            Profiler::save(profileFile);
+        }
+        if (!traceFile.empty())
+        {
+            Trace::save(traceFile);
+        }
     }
     catch (const std::exception &e)
     {
@@ -0,0 +1,116 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mappedfile.h"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string &filename)
+    : filename(filename)
+{
+    // Sharing delete access lets a newer version be moved into place while this one is mapped
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Failed to open " + filename);
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    length = static_cast<size_t>(fileSize.QuadPart);
+
+    HANDLE fileMapping = length ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    void *view = fileMapping ? MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view)
+    {
+        if (fileMapping) CloseHandle(fileMapping);
+        CloseHandle(file);
+        throw std::runtime_error("Failed to map " + filename);
+    }
+
+    fileHandle = file;
+    mappingHandle = fileMapping;
+    mapping = static_cast<const uint8_t *>(view);
+}
+
+MappedFile::~MappedFile()
+{
+    UnmapViewOfFile(mapping);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &filename)
+    : filename(filename)
+{
+    int file = open(filename.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        throw std::runtime_error("Failed to open " + filename);
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        close(file);
+        throw std::runtime_error("Failed to map " + filename);
+    }
+    length = static_cast<size_t>(status.st_size);
+
+    void *view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (view == MAP_FAILED)
+    {
+        throw std::runtime_error("Failed to map " + filename);
+    }
+
+    mapping = static_cast<const uint8_t *>(view);
+}
+
+MappedFile::~MappedFile()
+{
+    munmap(const_cast<uint8_t *>(mapping), length);
+}
+
+#endif
+
+const uint8_t *MappedFile::data() const
+{
+    return mapping;
+}
+
+size_t MappedFile::size() const
+{
+    return length;
+}
@@ -19,65 +19,139 @@
 
 #include "mesh.h"
 
+#include "extensions.h"
+#include "renderstate.h"
 #include "texture.h"
+#include "trace.h"
 
 Mesh::Mesh(std::shared_ptr<Texture> &texture)
     : texture(texture)
 {
+    internMaterial();
 }
 
-void Mesh::render() const
+void Mesh::render(const Matrix4f &worldMatrix) const
 {
-    Matrix4 worldMatrix = position * rotation * scale;
-
-    if (texture)
-    {
-        glBindTexture(GL_TEXTURE_2D, texture->id);
-    }
+    TRACE_ZONE("Mesh::render");
+    RenderState::bindTexture(texture ? texture->id : 0);
 
     glPushMatrix();
-    float worldMatrixF[16];
-    worldMatrix.toColumnMajor(worldMatrixF);
-    glMultMatrixf(worldMatrixF);
-
-    glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, (float *)&ambient);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, (float *)&diffuse);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, (float *)&specular);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, (float *)&emission);
-    glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, shininess);
-
-    glBegin(GL_QUADS);
-    for (auto vertex : vertices)
+    GL::multMatrix(worldMatrix);
+
+    applyMaterial();
+    applyBlendMode();
+    geometry->draw();
+
+    glPopMatrix();
+}
+
+/**
+ * Sets the material of this mesh, unchanged values are skipped by RenderState.
+ */
+void Mesh::applyMaterial() const
+{
+    RenderState::setMaterial(GL_AMBIENT, ambient);
+    RenderState::setMaterial(GL_DIFFUSE, diffuse);
+    RenderState::setMaterial(GL_SPECULAR, specular);
+    RenderState::setMaterial(GL_EMISSION, emission);
+    RenderState::setShininess(shininess);
+}
+
+/**
+ * Sets the blend function for the blend mode of this mesh.
+ */
+void Mesh::applyBlendMode() const
+{
+    switch (blendMode)
     {
-        glNormal3fv((float *)&vertex.normal);
-        glTexCoord2fv((float *)&vertex.texcoord);
-        glVertex3fv((float *)&vertex.position);
+        case BlendMode::Opaque:
+            RenderState::setBlendFunc(GL_ONE, GL_ZERO);
+            break;
+        case BlendMode::Additive:
+            RenderState::setBlendFunc(GL_ONE, GL_ONE);
+            break;
+        case BlendMode::Translucent:
+            RenderState::setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            break;
     }
-    glEnd();
-    glPopMatrix();
-    if (texture) glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void Mesh::setPosition(const Vector3 &position)
+/**
+ * Copies the geometry of this mesh to the GPU, see Geometry::upload().
+ *
+ * Must be called after the constructor of the derived class has filled the
+ * vertex list.
+ */
+void Mesh::upload(bool releaseVertices)
 {
-    this->position = Matrix4::translate(position.x, position.y, position.z);
+    geometry->upload(releaseVertices);
 }
 
-void Mesh::setRotation(const Vector3 &rotation)
+/**
+ * Gives meshes with several levels of detail the chance to pick the one that
+ * fits the current view. Called once per frame before render().
+ */
+void Mesh::selectDetail(const Camera &camera, bool fixedPosition, const Matrix4f &worldMatrix)
 {
-    this->rotation = Matrix4::rotateX(rotation.x) * Matrix4::rotateY(rotation.y) * Matrix4::rotateZ(rotation.z);
 }
 
-void Mesh::setScale(const double scale)
+/**
+ * Returns the bounds of the geometry in local coordinates.
+ */
+const Bounds &Mesh::getBounds() const
 {
-    this->scale = Matrix4::scale(scale);
+    return geometry->getBounds();
+}
+
+const std::shared_ptr<Geometry> &Mesh::getGeometry() const
+{
+    return geometry;
 }
 
 void Mesh::setMaterial(const Color &diffuse, const Color &specular, const Color &emission, const Color &ambient, const float shininess)
 {
-    std::copy(&diffuse.r, &diffuse.r + 3, this->diffuse);
-    std::copy(&specular.r, &specular.r + 3, this->specular);
-    std::copy(&emission.r, &emission.r + 3, this->emission);
-    std::copy(&ambient.r, &ambient.r + 3, this->ambient);
+    std::copy(&diffuse.r, &diffuse.r + 4, this->diffuse);
+    std::copy(&specular.r, &specular.r + 4, this->specular);
+    std::copy(&emission.r, &emission.r + 4, this->emission);
+    std::copy(&ambient.r, &ambient.r + 4, this->ambient);
     this->shininess = shininess;
-}
\ No newline at end of file
+    internMaterial();
+}
+
+void Mesh::setBlendMode(BlendMode blendMode)
+{
+    this->blendMode = blendMode;
+}
+
+BlendMode Mesh::getBlendMode() const
+{
+    return blendMode;
+}
+
+/**
+ * Returns the name of the texture, so meshes sharing a texture can be drawn
+ * one after another.
+ */
+uint32_t Mesh::getTextureId() const
+{
+    return texture ? texture->id : 0;
+}
+
+/**
+ * Returns a number that is the same for all meshes with an equal material.
+ */
+uint32_t Mesh::getMaterialId() const
+{
+    return materialId;
+}
+
+void Mesh::internMaterial()
+{
+    std::array<float, 17> key;
+    std::copy(diffuse, diffuse + 4, key.begin());
+    std::copy(specular, specular + 4, key.begin() + 4);
+    std::copy(emission, emission + 4, key.begin() + 8);
+    std::copy(ambient, ambient + 4, key.begin() + 12);
+    key[16] = shininess;
+    materialId = materialIds.try_emplace(key, static_cast<uint32_t>(materialIds.size())).first->second;
+}
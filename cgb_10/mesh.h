@@ -19,32 +19,57 @@
 
 #pragma once
 
+#include "camera.h"
 #include "cgmath.h"
+#include "geometry.h"
 #include "texture.h"
+#include "transform.h"
 
+#include <array>
+#include <cstdint>
+#include <map>
 #include <memory>
-#include <vector>
 
-class Mesh
+/**
+ * How a mesh is combined with what is already in the frame buffer. Blended
+ * meshes are drawn after the opaque ones and back to front, see RenderQueue.
+ */
+enum class BlendMode
+{
+    Opaque,
+    Additive,
+    Translucent
+};
+
+class Mesh : public Transform
 {
   public:
     Mesh(std::shared_ptr<Texture> &texture);
-    virtual ~Mesh() = default;
-    virtual void render() const;
-    void setPosition(const Vector3 &position);
-    void setRotation(const Vector3 &rotation);
-    void setScale(const double scale);
+    virtual void render(const Matrix4f &worldMatrix) const;
+    virtual void upload(bool releaseVertices = false);
+    virtual void selectDetail(const Camera &camera, bool fixedPosition, const Matrix4f &worldMatrix);
     void setMaterial(const Color &diffuse, const Color &specular, const Color &emission, const Color &ambient, const float shininess);
+    void setBlendMode(BlendMode blendMode);
+    BlendMode getBlendMode() const;
+    uint32_t getTextureId() const;
+    uint32_t getMaterialId() const;
+    virtual const Bounds &getBounds() const;
+    const std::shared_ptr<Geometry> &getGeometry() const;
 
   protected:
-    Matrix4 position = Matrix4::translate(0, 0,0);
-    Matrix4 rotation = Matrix4::rotateX(0.0);
-    Matrix4 scale = Matrix4::scale(1.0);
-    std::vector<Vertex> vertices = {};
+    void applyMaterial() const;
+    void applyBlendMode() const;
+    std::shared_ptr<Geometry> geometry = std::make_shared<Geometry>();
     std::shared_ptr<Texture> texture = nullptr;
-    float diffuse[3] = {1.0f, 1.0f, 1.0f};
-    float specular[3] = {1.0f, 1.0f, 1.0f};
-    float emission[3] = {0.0f, 0.0f, 0.0f};
-    float ambient[3] = {1.0f, 1.0f, 1.0f};
+    float diffuse[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float specular[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float emission[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    float ambient[4] = {1.0f, 1.0f, 1.0f, 1.0f};
     float shininess = 30.0f;
+    BlendMode blendMode = BlendMode::Opaque;
+    uint32_t materialId = 0;
+
+  private:
+    void internMaterial();
+    static inline std::map<std::array<float, 17>, uint32_t> materialIds;
 };
\ No newline at end of file
@@ -19,125 +19,572 @@
 
 #include "planet.h"
 
+#include "extensions.h"
+#include "profiler.h"
+#include "renderstate.h"
+#include "trace.h"
+#include "virtualtexture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Both shaders get their version directive and the functions that sample the
+// surface put in front of these sources.
+static const char *vertexSource = R"(
+varying vec3 normal;
+
+void main()
+{
+    normal = gl_NormalMatrix * gl_Normal;
+    gl_TexCoord[0] = gl_MultiTexCoord0;
+    gl_Position = ftransform();
+}
+)";
+
+// Evaluates the five passes of renderMultiPass() per fragment. The light
+// colors and directions are taken from GL_LIGHT2 to GL_LIGHT6 as set up in the
+// constructor, so both paths share them.
+static const char *fragmentSource = R"(
+uniform sampler2D dayTexture;
+uniform sampler2D nightTexture;
+uniform sampler2D specularTexture;
+
+varying vec3 normal;
+
+float facing(vec3 n, int light)
+{
+    return max(dot(n, normalize(gl_LightSource[light].position.xyz)), 0.0);
+}
+
+void main()
+{
+    vec3 n = normalize(normal);
+    vec2 uv = surfaceCoordinate(gl_TexCoord[0].st);
+    float sun = facing(n, 2);
+
+    // Atmosphere lit by the sun, reduced to a halo towards the edge of the disc
+    vec3 atmosphere = clamp(gl_LightSource[2].diffuse.rgb * sun, 0.0, 1.0);
+    atmosphere *= 1.0 - clamp(gl_LightSource[3].diffuse.rgb * facing(n, 3), 0.0, 1.0);
+
+    vec3 nightLight = clamp(gl_LightSource[4].ambient.rgb + gl_LightSource[4].diffuse.rgb * facing(n, 4), 0.0, 1.0);
+    vec3 night = surface(nightTexture, uv).rgb * nightLight;
+
+    vec3 dayLight = clamp(gl_LightSource[5].diffuse.rgb * sun, 0.0, 1.0);
+    vec3 day = surface(dayTexture, uv).rgb * dayLight;
+
+    // Additive blending saturates in the framebuffer
+    vec3 color = min(atmosphere + night + day, 1.0);
+
+    // Blinn-Phong with an infinite viewer, like the fixed-function pipeline
+    vec3 halfway = normalize(normalize(gl_LightSource[6].position.xyz) + vec3(0.0, 0.0, 1.0));
+    float highlight = sun > 0.0 ? pow(max(dot(n, halfway), 0.0), gl_FrontMaterial.shininess) : 0.0;
+    vec3 specular = surface(specularTexture, uv).rgb * clamp(gl_LightSource[6].specular.rgb * highlight, 0.0, 1.0);
+
+    gl_FragColor = vec4(specular + color * (1.0 - specular), 1.0);
+}
+)";
+
+static const char *textureSource = R"(#version 120
+
+vec2 surfaceCoordinate(vec2 uv)
+{
+    return uv;
+}
+
+vec4 surface(sampler2D map, vec2 uv)
+{
+    return texture2D(map, uv);
+}
+)";
+
+// Follows the functions of VirtualTexture, the samplers are its cache textures
+static const char *virtualTextureSource = R"(
+vec2 surfaceCoordinate(vec2 uv)
+{
+    return virtualCoordinate(uv);
+}
+
+vec4 surface(sampler2D map, vec2 uv)
+{
+    return textureLod(map, uv, 0.0);
+}
+)";
+
+// Planets with a virtual texture have no texture of their own
+static std::shared_ptr<Texture> noTexture = nullptr;
+
 Planet::Planet(std::shared_ptr<Texture> &texture, std::shared_ptr<Texture> &specularTexture, std::shared_ptr<Texture> &nightTexture)
     : Sphere(texture), specularTexture(specularTexture), nightTexture(nightTexture)
+{
+    setUpLights();
+}
+
+/**
+ * A planet whose textures are too large for single textures.
+ *
+ * @param surface Virtual texture with the layers day, night and specular, in this order.
+ */
+Planet::Planet(std::shared_ptr<VirtualTexture> &surface)
+    : Sphere(noTexture), surface(surface)
+{
+    setUpLights();
+}
+
+void Planet::setUpLights()
 {
     // Custom lights
-    float black[3] = {0.0f, 0.0f, 0.0f};
-    float white[3] = {1.0f, 1.0f, 1.0f};
-    float white2[3] = {1.05f, 1.05f, 1.05f};
-    float nightLightBright[3] = {0.3f, 0.3f, 0.3f};
-    float nightLightDark[3] = {0.1f, 0.1f, 0.1f};
-    float blue[3] = {0.397f, 0.587f, 1.0f};
+    float black[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    float white[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float white2[4] = {1.05f, 1.05f, 1.05f, 1.0f};
+    float nightLightBright[4] = {0.3f, 0.3f, 0.3f, 1.0f};
+    float nightLightDark[4] = {0.1f, 0.1f, 0.1f, 1.0f};
+    float blue[4] = {0.397f, 0.587f, 1.0f, 1.0f};
 
     // Light 2 is the sun with blue tint
-    glLightfv(GL_LIGHT2, GL_DIFFUSE, blue);
-    glLightfv(GL_LIGHT2, GL_SPECULAR, black);
-    glLightfv(GL_LIGHT2, GL_AMBIENT, black);
+    RenderState::setLight(GL_LIGHT2, GL_DIFFUSE, blue);
+    RenderState::setLight(GL_LIGHT2, GL_SPECULAR, black);
+    RenderState::setLight(GL_LIGHT2, GL_AMBIENT, black);
 
     // Light 3 is diffuse light shining in the direction of the camera
     float lightPositionF[4] = {0.0f, 0.0f, 50000.0f, 0.0f};
-    glLightfv(GL_LIGHT3, GL_DIFFUSE, white2);
-    glLightfv(GL_LIGHT3, GL_SPECULAR, black);
-    glLightfv(GL_LIGHT3, GL_AMBIENT, black);
-    glLightfv(GL_LIGHT3, GL_POSITION, lightPositionF);
+    RenderState::setLight(GL_LIGHT3, GL_DIFFUSE, white2);
+    RenderState::setLight(GL_LIGHT3, GL_SPECULAR, black);
+    RenderState::setLight(GL_LIGHT3, GL_AMBIENT, black);
+    RenderState::setLight(GL_LIGHT3, GL_POSITION, lightPositionF);
 
     // Light 4 is the night light
-    glLightfv(GL_LIGHT4, GL_DIFFUSE, nightLightBright);
-    glLightfv(GL_LIGHT4, GL_SPECULAR, black);
-    glLightfv(GL_LIGHT4, GL_AMBIENT, nightLightDark);
+    RenderState::setLight(GL_LIGHT4, GL_DIFFUSE, nightLightBright);
+    RenderState::setLight(GL_LIGHT4, GL_SPECULAR, black);
+    RenderState::setLight(GL_LIGHT4, GL_AMBIENT, nightLightDark);
 
     // Light 5 is the sun with only diffuse light
-    glLightfv(GL_LIGHT5, GL_DIFFUSE, white);
-    glLightfv(GL_LIGHT5, GL_SPECULAR, black);
-    glLightfv(GL_LIGHT5, GL_AMBIENT, black);
+    RenderState::setLight(GL_LIGHT5, GL_DIFFUSE, white);
+    RenderState::setLight(GL_LIGHT5, GL_SPECULAR, black);
+    RenderState::setLight(GL_LIGHT5, GL_AMBIENT, black);
 
     // Light 6 is the sun with only specular light
-    glLightfv(GL_LIGHT6, GL_DIFFUSE, black);
-    glLightfv(GL_LIGHT6, GL_SPECULAR, white);
-    glLightfv(GL_LIGHT6, GL_AMBIENT, black);
+    RenderState::setLight(GL_LIGHT6, GL_DIFFUSE, black);
+    RenderState::setLight(GL_LIGHT6, GL_SPECULAR, white);
+    RenderState::setLight(GL_LIGHT6, GL_AMBIENT, black);
 }
 
-void Planet::render() const
+void Planet::render(const Matrix4f &worldMatrix) const
 {
-    Matrix4 worldMatrix = position * rotation * scale;
-    float worldMatrixF[16];
-    worldMatrix.toColumnMajor(worldMatrixF);
-
+    TRACE_ZONE("Planet::render");
     float lightPositionSun[4] = {0.0f, 0.0f, 50000.0f, 0.0f};
-    glLightfv(GL_LIGHT2, GL_POSITION, lightPositionSun);
-    glLightfv(GL_LIGHT5, GL_POSITION, lightPositionSun);
-    glLightfv(GL_LIGHT6, GL_POSITION, lightPositionSun);
+    RenderState::setLight(GL_LIGHT2, GL_POSITION, lightPositionSun);
+    RenderState::setLight(GL_LIGHT5, GL_POSITION, lightPositionSun);
+    RenderState::setLight(GL_LIGHT6, GL_POSITION, lightPositionSun);
     float lightPositionInverse[4] = {0.0f, 0.0f, -50000.0f, 0.0f};
-    glLightfv(GL_LIGHT7, GL_POSITION, lightPositionInverse);
+    RenderState::setLight(GL_LIGHT7, GL_POSITION, lightPositionInverse);
+
+    // The other paths cannot look up tiles, so virtual textures always use the shader
+    if (surface)
+    {
+        renderVirtual(worldMatrix);
+        return;
+    }
+
+    switch (shading)
+    {
+        case PlanetShading::SinglePass:
+            renderSinglePass(worldMatrix);
+            break;
+        case PlanetShading::Combiners:
+            renderCombiners(worldMatrix);
+            break;
+        case PlanetShading::MultiPass:
+            renderMultiPass(worldMatrix);
+            break;
+    }
+}
+
+/**
+ * Samples the day, night and specular textures in one pass, see
+ * fragmentSource for how the passes of renderMultiPass() are combined.
+ */
+void Planet::renderSinglePass(const Matrix4f &worldMatrix) const
+{
+    const Shader &shader = getShader();
+    shader.use();
+    GL::Uniform1i(shader.getUniform("dayTexture"), 0);
+    GL::Uniform1i(shader.getUniform("nightTexture"), 1);
+    GL::Uniform1i(shader.getUniform("specularTexture"), 2);
+
+    RenderState::setActiveTexture(GL_TEXTURE0 + 2);
+    RenderState::bindTexture(specularTexture->id);
+    RenderState::setActiveTexture(GL_TEXTURE0 + 1);
+    RenderState::bindTexture(nightTexture->id);
+    RenderState::setActiveTexture(GL_TEXTURE0);
+    RenderState::bindTexture(texture->id);
+
+    RenderState::setBlendFunc(GL_ONE, GL_ZERO);
+    renderQuads(worldMatrix, "planet single pass");
+
+    RenderState::setActiveTexture(GL_TEXTURE0 + 2);
+    RenderState::bindTexture(0);
+    RenderState::setActiveTexture(GL_TEXTURE0 + 1);
+    RenderState::bindTexture(0);
+    RenderState::setActiveTexture(GL_TEXTURE0);
+    RenderState::bindTexture(0);
+    Shader::useFixedFunction();
+}
+
+/**
+ * Draws the feedback pass of the virtual texture, then the planet with the
+ * single pass shader, sampling all three layers at the coordinate from
+ * the page table.
+ */
+void Planet::renderVirtual(const Matrix4f &worldMatrix) const
+{
+    RenderState::setBlendFunc(GL_ONE, GL_ZERO);
+    if (surface->beginFeedback())
+    {
+        renderQuads(worldMatrix, "planet feedback");
+        surface->endFeedback();
+    }
+
+    const Shader &shader = getVirtualShader();
+    shader.use();
+    GL::Uniform1i(shader.getUniform("dayTexture"), 0);
+    GL::Uniform1i(shader.getUniform("nightTexture"), 1);
+    GL::Uniform1i(shader.getUniform("specularTexture"), 2);
+    surface->bind(shader);
+    renderQuads(worldMatrix, "planet virtual texture");
+    surface->unbind();
+    Shader::useFixedFunction();
+}
+
+/**
+ * Sets up a GL_COMBINE stage on the active texture unit. All operands are
+ * colors except the third color operand, alpha operands are alpha values.
+ */
+static void setCombiner(GLenum function, GLenum source0, GLenum source1, GLenum source2, GLenum operand2,
+                        GLenum alphaFunction, GLenum alphaSource0, GLenum alphaSource1)
+{
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
+    glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, function);
+    glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, source0);
+    glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_RGB, GL_SRC_COLOR);
+    glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_RGB, source1);
+    glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_RGB, GL_SRC_COLOR);
+    glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE2_RGB, source2);
+    glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND2_RGB, operand2);
+    glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_ALPHA, alphaFunction);
+    glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_ALPHA, alphaSource0);
+    glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_ALPHA, GL_SRC_ALPHA);
+    glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_ALPHA, alphaSource1);
+    glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_ALPHA, GL_SRC_ALPHA);
+}
 
+/**
+ * Enables a texture unit for one of the lookup textures, with the texture
+ * coordinates generated from the object space position.
+ */
+static void bindLookup(GLuint lookup, const float *planeS, const float *planeT)
+{
+    glEnable(GL_TEXTURE_2D);
+    RenderState::bindTexture(lookup);
+    glTexGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+    glTexGeni(GL_T, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+    glTexGenfv(GL_S, GL_OBJECT_PLANE, planeS);
+    glTexGenfv(GL_T, GL_OBJECT_PLANE, planeT);
+    glEnable(GL_TEXTURE_GEN_S);
+    glEnable(GL_TEXTURE_GEN_T);
+}
+
+static void resetUnit(GLenum unit)
+{
+    RenderState::setActiveTexture(unit);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glDisable(GL_TEXTURE_GEN_S);
+    glDisable(GL_TEXTURE_GEN_T);
+    RenderState::bindTexture(0);
+    if (unit != GL_TEXTURE0) glDisable(GL_TEXTURE_2D);
+}
+
+/**
+ * Folds the five passes into two for OpenGL 1.3 contexts without shaders.
+ *
+ * A texture stage can multiply only once before adding to the previous
+ * result, so the terms are split by what they are multiplied with:
+ *  1. day * N.L from the lighting plus the atmosphere from a lookup texture.
+ *  2. night * (ambient + N.V) from the lighting plus the specular texture
+ *     times a highlight lookup, combined in alpha so that the blending
+ *     src + dst * (1 - alpha) reproduces the specular pass exactly.
+ * The lookup textures are indexed with the cosines of the angles between
+ * the normal and the sun, the viewer and the half vector. On the unit sphere
+ * these are linear in the position, so they come from texture generation.
+ */
+void Planet::renderCombiners(const Matrix4f &worldMatrix) const
+{
+    float modelView[16];
+    glPushMatrix();
+    GL::multMatrix(worldMatrix);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelView);
+    glPopMatrix();
+
+    // Maps a direction in eye space to s = 0.5 + 0.5 * N.direction
+    auto toPlane = [&modelView](const float *direction, float *plane)
+    {
+        float length = 0.0f;
+        for (int column = 0; column < 3; column++)
+        {
+            const float *axis = modelView + column * 4;
+            plane[column] = axis[0] * direction[0] + axis[1] * direction[1] + axis[2] * direction[2];
+            length += plane[column] * plane[column];
+        }
+        for (int column = 0; column < 3; column++) plane[column] *= 0.5f / std::sqrt(length);
+        plane[3] = 0.5f;
+    };
+
+    float sun[4];
+    glGetLightfv(GL_LIGHT5, GL_POSITION, sun);
+    float sunLength = std::sqrt(sun[0] * sun[0] + sun[1] * sun[1] + sun[2] * sun[2]);
+    float view[3] = {0.0f, 0.0f, 1.0f};
+    float halfway[3] = {sun[0] / sunLength, sun[1] / sunLength, sun[2] / sunLength + 1.0f};
+    float sunPlane[4], viewPlane[4], halfwayPlane[4];
+    toPlane(sun, sunPlane);
+    toPlane(view, viewPlane);
+    toPlane(halfway, halfwayPlane);
+
+    if (!atmosphereLookup) atmosphereLookup = createAtmosphereLookup();
+    if (!highlightLookup) highlightLookup = createHighlightLookup(shininess);
+
+    RenderState::setLightEnabled(GL_LIGHT1, false);
+
+    // Day and atmosphere
+    RenderState::setActiveTexture(GL_TEXTURE0);
+    RenderState::bindTexture(texture->id);
+    setCombiner(GL_MODULATE, GL_TEXTURE, GL_PRIMARY_COLOR, GL_PRIMARY_COLOR, GL_SRC_COLOR, GL_REPLACE, GL_TEXTURE, GL_TEXTURE);
+    RenderState::setActiveTexture(GL_TEXTURE0 + 1);
+    bindLookup(atmosphereLookup, sunPlane, viewPlane);
+    setCombiner(GL_ADD, GL_PREVIOUS, GL_TEXTURE, GL_TEXTURE, GL_SRC_COLOR, GL_REPLACE, GL_PREVIOUS, GL_PREVIOUS);
+
+    RenderState::setBlendFunc(GL_ONE, GL_ZERO);
+    RenderState::setLightEnabled(GL_LIGHT5, true);
+    renderQuads(worldMatrix, "planet day and atmosphere");
+    RenderState::setLightEnabled(GL_LIGHT5, false);
+    resetUnit(GL_TEXTURE0 + 1);
+
+    // Night and specular reflections, drawn over the same depth values
+    float white[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    RenderState::setActiveTexture(GL_TEXTURE0);
+    RenderState::bindTexture(specularTexture->id);
+    setCombiner(GL_REPLACE, GL_TEXTURE, GL_TEXTURE, GL_TEXTURE, GL_SRC_COLOR, GL_REPLACE, GL_TEXTURE, GL_TEXTURE);
+    RenderState::setActiveTexture(GL_TEXTURE0 + 1);
+    bindLookup(highlightLookup, halfwayPlane, sunPlane);
+    setCombiner(GL_REPLACE, GL_PREVIOUS, GL_PREVIOUS, GL_PREVIOUS, GL_SRC_COLOR, GL_MODULATE, GL_PREVIOUS, GL_TEXTURE);
+    RenderState::setActiveTexture(GL_TEXTURE0 + 2);
+    glEnable(GL_TEXTURE_2D);
+    RenderState::bindTexture(nightTexture->id);
+    setCombiner(GL_MODULATE, GL_TEXTURE, GL_PRIMARY_COLOR, GL_PRIMARY_COLOR, GL_SRC_COLOR, GL_REPLACE, GL_PREVIOUS, GL_PREVIOUS);
+    RenderState::setActiveTexture(GL_TEXTURE0 + 3);
+    glEnable(GL_TEXTURE_2D);
+    RenderState::bindTexture(highlightLookup);
+    glTexEnvfv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_COLOR, white);
+    setCombiner(GL_INTERPOLATE, GL_CONSTANT, GL_PREVIOUS, GL_PREVIOUS, GL_SRC_ALPHA, GL_REPLACE, GL_PREVIOUS, GL_PREVIOUS);
+
+    GLint depthFunction;
+    glGetIntegerv(GL_DEPTH_FUNC, &depthFunction);
+    glDepthFunc(GL_LEQUAL);
+    RenderState::setBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    RenderState::setLightEnabled(GL_LIGHT4, true);
+    renderQuads(worldMatrix, "planet night and specular", 3);
+    RenderState::setLightEnabled(GL_LIGHT4, false);
+    glDepthFunc(depthFunction);
+
+    resetUnit(GL_TEXTURE0 + 3);
+    resetUnit(GL_TEXTURE0 + 2);
+    resetUnit(GL_TEXTURE0 + 1);
+    resetUnit(GL_TEXTURE0);
+    RenderState::setBlendFunc(GL_ONE, GL_ZERO);
+    RenderState::setLightEnabled(GL_LIGHT1, true);
+}
+
+/**
+ * The original fixed-function version, used where shaders are not available.
+ */
+void Planet::renderMultiPass(const Matrix4f &worldMatrix) const
+{
     // Disable default light
-    glDisable(GL_LIGHT1);
+    RenderState::setLightEnabled(GL_LIGHT1, false);
+
+    // Later passes draw the same surface again, clearing the depth buffer instead would lose nearer meshes drawn before
+    GLint depthFunction;
+    glGetIntegerv(GL_DEPTH_FUNC, &depthFunction);
 
     // render athmosphere
-    glBlendFunc(GL_ONE, GL_ZERO);
-    glEnable(GL_LIGHT2);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    renderQuads(worldMatrixF);
-    glDisable(GL_LIGHT2);
+    RenderState::setBlendFunc(GL_ONE, GL_ZERO);
+    RenderState::setLightEnabled(GL_LIGHT2, true);
+    RenderState::bindTexture(0);
+    renderQuads(worldMatrix, "planet atmosphere");
+    RenderState::setLightEnabled(GL_LIGHT2, false);
 
     // reduce athmosphere to halo
-    glBlendFunc(GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_LIGHT3);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    renderQuads(worldMatrixF);
-    glDisable(GL_LIGHT3);
+    RenderState::setBlendFunc(GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+    glDepthFunc(GL_LEQUAL);
+    RenderState::setLightEnabled(GL_LIGHT3, true);
+    RenderState::bindTexture(0);
+    renderQuads(worldMatrix, "planet halo");
+    RenderState::setLightEnabled(GL_LIGHT3, false);
 
     // render night texture
-    glBlendFunc(GL_ONE, GL_ONE);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_LIGHT4);
-    glBindTexture(GL_TEXTURE_2D, nightTexture->id);
-    renderQuads(worldMatrixF);
-    glDisable(GL_LIGHT4);
+    RenderState::setBlendFunc(GL_ONE, GL_ONE);
+    RenderState::setLightEnabled(GL_LIGHT4, true);
+    RenderState::bindTexture(nightTexture->id);
+    renderQuads(worldMatrix, "planet night");
+    RenderState::setLightEnabled(GL_LIGHT4, false);
 
     // render day texture
-    glBlendFunc(GL_ONE, GL_ONE);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_LIGHT5);
-    glBindTexture(GL_TEXTURE_2D, texture->id);
-    renderQuads(worldMatrixF);
-    glDisable(GL_LIGHT5);
+    RenderState::setBlendFunc(GL_ONE, GL_ONE);
+    RenderState::setLightEnabled(GL_LIGHT5, true);
+    RenderState::bindTexture(texture->id);
+    renderQuads(worldMatrix, "planet day");
+    RenderState::setLightEnabled(GL_LIGHT5, false);
 
     // render specular reflections
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_COLOR);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_LIGHT6);
-    glBindTexture(GL_TEXTURE_2D, specularTexture->id);
-    renderQuads(worldMatrixF);
-    glDisable(GL_LIGHT6);
+    RenderState::setBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_COLOR);
+    RenderState::setLightEnabled(GL_LIGHT6, true);
+    RenderState::bindTexture(specularTexture->id);
+    renderQuads(worldMatrix, "planet specular");
+    RenderState::setLightEnabled(GL_LIGHT6, false);
 
     // Restore all settings to default
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glBlendFunc(GL_ONE, GL_ZERO);
-    glEnable(GL_LIGHT1);
+    glDepthFunc(depthFunction);
+    RenderState::bindTexture(0);
+    RenderState::setBlendFunc(GL_ONE, GL_ZERO);
+    RenderState::setLightEnabled(GL_LIGHT1, true);
 }
 
-void Planet::renderQuads(const float *worldMatrix) const
+/**
+ * Draws the sphere once for a pass, which is measured as a profiler phase of the given name.
+ */
+void Planet::renderQuads(const Matrix4f &worldMatrix, const char *pass, GLint textureUnits) const
 {
+    Profiler::Scope scope(pass);
     glPushMatrix();
-    glMultMatrixf(worldMatrix);
+    GL::multMatrix(worldMatrix);
+
+    applyMaterial();
+    geometry->draw(textureUnits);
+
+    glPopMatrix();
+}
 
-    glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, (float *)&ambient);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, (float *)&diffuse);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, (float *)&specular);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, (float *)&emission);
-    glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, shininess);
+/**
+ * The shader is compiled on first use and never deleted, see InstancedMesh.
+ */
+const Shader &Planet::getShader()
+{
+    static const Shader *shader = new Shader(std::string("#version 120\n") + vertexSource, std::string(textureSource) + fragmentSource);
+    return *shader;
+}
+
+const Shader &Planet::getVirtualShader()
+{
+    static const Shader *shader = new Shader(std::string("#version 130\n") + vertexSource,
+                                             std::string("#version 130\n") + VirtualTexture::getShaderSource() + virtualTextureSource + fragmentSource);
+    return *shader;
+}
+
+static GLuint createLookup(int width, int height, const std::vector<uint8_t> &texels)
+{
+    GLuint id;
+    glGenTextures(1, &id);
+    RenderState::bindTexture(id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+    RenderState::bindTexture(0);
+    return id;
+}
+
+/**
+ * Atmosphere of the first two passes of renderMultiPass(), indexed with
+ * s = 0.5 + 0.5 * N.L and t = 0.5 + 0.5 * N.V. Light colors are read from
+ * GL_LIGHT2 and GL_LIGHT3 as set up in the constructor.
+ */
+GLuint Planet::createAtmosphereLookup()
+{
+    const int size = 64;
+    float atmosphereLight[4], haloLight[4];
+    glGetLightfv(GL_LIGHT2, GL_DIFFUSE, atmosphereLight);
+    glGetLightfv(GL_LIGHT3, GL_DIFFUSE, haloLight);
 
-    glBegin(GL_QUADS);
-    for (auto vertex : vertices)
+    std::vector<uint8_t> texels(size * size * 4);
+    for (int t = 0; t < size; t++)
     {
-        glNormal3fv((float *)&vertex.normal);
-        glTexCoord2fv((float *)&vertex.texcoord);
-        glVertex3fv((float *)&vertex.position);
+        float view = std::max((t + 0.5f) / size * 2.0f - 1.0f, 0.0f);
+        for (int s = 0; s < size; s++)
+        {
+            float sun = std::max((s + 0.5f) / size * 2.0f - 1.0f, 0.0f);
+            uint8_t *texel = &texels[(t * size + s) * 4];
+            for (int i = 0; i < 3; i++)
+            {
+                float atmosphere = std::min(atmosphereLight[i] * sun, 1.0f) * (1.0f - std::min(haloLight[i] * view, 1.0f));
+                texel[i] = static_cast<uint8_t>(atmosphere * 255.0f + 0.5f);
+            }
+            texel[3] = 255;
+        }
     }
-    glEnd();
+    return createLookup(size, size, texels);
+}
 
-    glPopMatrix();
-}
\ No newline at end of file
+/**
+ * Specular highlight in the alpha channel, indexed with s = 0.5 + 0.5 * N.H
+ * and t = 0.5 + 0.5 * N.L. Like the fixed-function lighting there is no
+ * highlight on the side facing away from the sun. The exponent makes the
+ * highlight narrow, so N.H gets a finer resolution than N.L.
+ */
+GLuint Planet::createHighlightLookup(float shininess)
+{
+    const int width = 512;
+    const int height = 16;
+
+    std::vector<uint8_t> texels(width * height * 4);
+    for (int t = 0; t < height; t++)
+    {
+        bool lit = (t + 0.5f) / height > 0.5f;
+        for (int s = 0; s < width; s++)
+        {
+            float halfway = std::max((s + 0.5f) / width * 2.0f - 1.0f, 0.0f);
+            float highlight = lit ? std::pow(halfway, shininess) : 0.0f;
+            uint8_t *texel = &texels[(t * width + s) * 4];
+            texel[0] = texel[1] = texel[2] = 255;
+            texel[3] = static_cast<uint8_t>(std::min(highlight, 1.0f) * 255.0f + 0.5f);
+        }
+    }
+    return createLookup(width, height, texels);
+}
+
+bool Planet::isSupported(PlanetShading shading)
+{
+    switch (shading)
+    {
+        case PlanetShading::SinglePass:
+            return GL::hasShaders();
+        case PlanetShading::Combiners:
+            return GL::hasTextureCombiners(4);
+        case PlanetShading::MultiPass:
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Chooses the shading path for all planets. The support is checked here
+ * rather than every frame, unsupported paths fall back to five passes.
+ */
+void Planet::setShading(PlanetShading shading)
+{
+    Planet::shading = isSupported(shading) ? shading : PlanetShading::MultiPass;
+}
+
+PlanetShading Planet::getShading()
+{
+    return shading;
+}
@@ -19,16 +19,43 @@
 
 #pragma once
 
+#include "shader.h"
 #include "sphere.h"
 
+class VirtualTexture;
+
+enum class PlanetShading
+{
+    MultiPass,
+    Combiners,
+    SinglePass
+};
+
 class Planet : public Sphere
 {
   public:
     Planet(std::shared_ptr<Texture> &texture, std::shared_ptr<Texture> &specularTexture, std::shared_ptr<Texture> &nightTexture);
-    void render() const override;
+    Planet(std::shared_ptr<VirtualTexture> &surface);
+    void render(const Matrix4f &worldMatrix) const override;
+    static void setShading(PlanetShading shading);
+    static PlanetShading getShading();
+    static bool isSupported(PlanetShading shading);
 
   private:
-    void renderQuads(const float *worldMatrix) const;
+    static void setUpLights();
+    void renderVirtual(const Matrix4f &worldMatrix) const;
+    void renderMultiPass(const Matrix4f &worldMatrix) const;
+    void renderCombiners(const Matrix4f &worldMatrix) const;
+    void renderSinglePass(const Matrix4f &worldMatrix) const;
+    void renderQuads(const Matrix4f &worldMatrix, const char *pass, GLint textureUnits = 1) const;
+    static const Shader &getShader();
+    static const Shader &getVirtualShader();
+    static GLuint createAtmosphereLookup();
+    static GLuint createHighlightLookup(float shininess);
     std::shared_ptr<Texture> specularTexture = nullptr;
     std::shared_ptr<Texture> nightTexture = nullptr;
+    std::shared_ptr<VirtualTexture> surface = nullptr;
+    mutable GLuint atmosphereLookup = 0;
+    mutable GLuint highlightLookup = 0;
+    static inline PlanetShading shading = PlanetShading::MultiPass;
 };
\ No newline at end of file
@@ -0,0 +1,317 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "profiler.h"
+
+#include "extensions.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <stdexcept>
+
+Profiler::Scope::Scope(const char *name)
+    : phase(getPhase(name)), query(beginQuery()), start(std::chrono::steady_clock::now())
+{
+}
+
+Profiler::Scope::~Scope()
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    add(phases[phase].cpu, frame, elapsed.count());
+    if (query != noQuery) endQuery(phase, query);
+}
+
+/**
+ * Ends the previous frame and starts the next one. The time between two
+ * calls is the frame time.
+ */
+void Profiler::beginFrame()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (frameStart != std::chrono::steady_clock::time_point{})
+    {
+        std::chrono::duration<double, std::milli> elapsed = now - frameStart;
+        frameTimes[frame % historySize] = static_cast<float>(elapsed.count());
+        frame++;
+    }
+    frameStart = now;
+
+    size_t slot = frame % historySize;
+    frameTimes[slot] = -1.0f;
+    for (Phase &phase : phases)
+    {
+        phase.cpu[slot] = -1.0f;
+        phase.gpu[slot] = -1.0f;
+    }
+
+    // The queries of this slot were issued queryLatency frames ago
+    QueryFrame &queryFrame = queryFrames[frame % queryLatency];
+    collectQueries(queryFrame);
+    queryFrame.frame = frame;
+}
+
+Profiler::Percentiles Profiler::getFramePercentiles()
+{
+    return computePercentiles(frameTimes);
+}
+
+/**
+ * Returns the percentiles of a phase over the recorded frames in which it
+ * ran, in milliseconds.
+ *
+ * @param gpu True for the GPU time, false for the CPU time.
+ */
+Profiler::Percentiles Profiler::getPercentiles(const std::string &phase, bool gpu)
+{
+    for (const Phase &candidate : phases)
+    {
+        if (phase == candidate.name) return computePercentiles(gpu ? candidate.gpu : candidate.cpu);
+    }
+    return {};
+}
+
+/**
+ * Prints a table with the percentiles of the frame time and of every phase.
+ */
+void Profiler::printReport(std::ostream &stream)
+{
+    std::ios_base::fmtflags flags = stream.flags();
+    std::streamsize precision = stream.precision();
+    auto printRow = [&stream](const char *name, const Percentiles &cpu, const Percentiles *gpu)
+    {
+        stream << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2);
+        for (double value : {cpu.p50, cpu.p95, cpu.p99, cpu.max}) stream << std::setw(9) << value;
+        if (gpu && gpu->samples)
+        {
+            stream << "  |";
+            for (double value : {gpu->p50, gpu->p95, gpu->p99, gpu->max}) stream << std::setw(9) << value;
+        }
+        stream << std::endl;
+    };
+
+    Percentiles frames = getFramePercentiles();
+    stream << "Profile of the last " << frames.samples << " frames in ms" << std::endl;
+    stream << std::left << std::setw(24) << "phase" << std::right;
+    for (const char *column : {"cpu p50", "p95", "p99", "max"}) stream << std::setw(9) << column;
+    stream << "  |";
+    for (const char *column : {"gpu p50", "p95", "p99", "max"}) stream << std::setw(9) << column;
+    stream << std::endl;
+
+    printRow("frame", frames, nullptr);
+    for (const Phase &phase : phases)
+    {
+        Percentiles gpu = computePercentiles(phase.gpu);
+        printRow(phase.name, computePercentiles(phase.cpu), &gpu);
+    }
+    stream.flags(flags);
+    stream.precision(precision);
+}
+
+/**
+ * Writes the recorded frames to a file, as JSON if the name ends in .json
+ * and as CSV with one row per frame otherwise.
+ */
+void Profiler::save(const std::string &filename)
+{
+    std::ofstream file(filename);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write profile: " + filename);
+    }
+
+    bool json = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+    if (json)
+    {
+        writeJson(file);
+    }
+    else
+    {
+        writeCsv(file);
+    }
+}
+
+uint32_t Profiler::getPhase(const char *name)
+{
+    for (uint32_t i = 0; i < phases.size(); i++)
+    {
+        if (phases[i].name == name || std::strcmp(phases[i].name, name) == 0) return i;
+    }
+    phases.push_back({name, std::vector<float>(historySize, -1.0f), std::vector<float>(historySize, -1.0f)});
+    return static_cast<uint32_t>(phases.size() - 1);
+}
+
+/**
+ * Issues a timestamp query at the start of a phase.
+ *
+ * @return The index of the query in the current query frame, or noQuery.
+ */
+uint32_t Profiler::beginQuery()
+{
+    if (timerQueries < 0) timerQueries = GL::hasTimerQueries() ? 1 : 0;
+    if (!timerQueries) return noQuery;
+
+    return issueQuery(queryFrames[frame % queryLatency]);
+}
+
+void Profiler::endQuery(uint32_t phase, uint32_t begin)
+{
+    QueryFrame &queryFrame = queryFrames[frame % queryLatency];
+    queryFrame.pending.push_back({phase, begin, issueQuery(queryFrame)});
+}
+
+/**
+ * Records a timestamp with the next free query, creating more queries if
+ * nested phases have used them all.
+ */
+uint32_t Profiler::issueQuery(QueryFrame &queryFrame)
+{
+    if (queryFrame.used == queryFrame.queries.size())
+    {
+        size_t available = queryFrame.queries.size();
+        queryFrame.queries.resize(available + 32);
+        GL::GenQueries(32, queryFrame.queries.data() + available);
+    }
+    GL::QueryCounter(queryFrame.queries[queryFrame.used], GL_TIMESTAMP);
+    return queryFrame.used++;
+}
+
+/**
+ * Adds the GPU times of the queries to the frame they were issued in.
+ * Queries that are still not available are dropped rather than waited for.
+ */
+void Profiler::collectQueries(QueryFrame &queryFrame)
+{
+    bool recorded = frame - queryFrame.frame < historySize;
+    for (const PendingQuery &pending : queryFrame.pending)
+    {
+        GLint available = 0;
+        GL::GetQueryObjectiv(queryFrame.queries[pending.end], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available || !recorded) continue;
+
+        uint64_t begin = 0, end = 0;
+        GL::GetQueryObjectui64v(queryFrame.queries[pending.begin], GL_QUERY_RESULT, &begin);
+        GL::GetQueryObjectui64v(queryFrame.queries[pending.end], GL_QUERY_RESULT, &end);
+        add(phases[pending.phase].gpu, queryFrame.frame, (end - begin) / 1.0e6);
+    }
+    queryFrame.pending.clear();
+    queryFrame.used = 0;
+}
+
+/**
+ * Adds to the time of a phase in a frame, phases can run several times per frame.
+ */
+void Profiler::add(std::vector<float> &samples, uint64_t frame, double milliseconds)
+{
+    float &sample = samples[frame % historySize];
+    sample = sample < 0.0f ? static_cast<float>(milliseconds) : sample + static_cast<float>(milliseconds);
+}
+
+/**
+ * Nearest rank percentiles of the samples, negative samples mark frames
+ * without a measurement.
+ */
+Profiler::Percentiles Profiler::computePercentiles(const std::vector<float> &samples)
+{
+    std::vector<float> sorted;
+    sorted.reserve(samples.size());
+    std::copy_if(samples.begin(), samples.end(), std::back_inserter(sorted), [](float sample) { return sample >= 0.0f; });
+    if (sorted.empty()) return {};
+
+    std::sort(sorted.begin(), sorted.end());
+    auto rank = [&sorted](double percentile)
+    {
+        size_t index = static_cast<size_t>(std::ceil(percentile * sorted.size()));
+        return static_cast<double>(sorted[std::clamp<size_t>(index, 1, sorted.size()) - 1]);
+    };
+    return {rank(0.50), rank(0.95), rank(0.99), sorted.back(), sorted.size()};
+}
+
+void Profiler::writeCsv(std::ostream &stream)
+{
+    stream << "frame,frame_ms";
+    for (const Phase &phase : phases) stream << "," << phase.name << " cpu_ms," << phase.name << " gpu_ms";
+    stream << "\n";
+
+    // Oldest recorded frame first, the frame in progress is left out
+    uint64_t first = frame >= historySize ? frame - historySize + 1 : 0;
+    for (uint64_t i = first; i < frame; i++)
+    {
+        size_t slot = i % historySize;
+        stream << i << "," << frameTimes[slot];
+        for (const Phase &phase : phases)
+        {
+            stream << ",";
+            if (phase.cpu[slot] >= 0.0f) stream << phase.cpu[slot];
+            stream << ",";
+            if (phase.gpu[slot] >= 0.0f) stream << phase.gpu[slot];
+        }
+        stream << "\n";
+    }
+}
+
+void Profiler::writeJson(std::ostream &stream)
+{
+    auto writePercentiles = [&stream](const Percentiles &percentiles)
+    {
+        stream << "{\"p50\": " << percentiles.p50 << ", \"p95\": " << percentiles.p95 << ", \"p99\": " << percentiles.p99
+               << ", \"max\": " << percentiles.max << ", \"samples\": " << percentiles.samples << "}";
+    };
+    auto writeSamples = [&stream](const std::vector<float> &samples, uint64_t first, uint64_t last)
+    {
+        stream << "[";
+        for (uint64_t i = first; i < last; i++)
+        {
+            if (i > first) stream << ", ";
+            float sample = samples[i % historySize];
+            if (sample >= 0.0f)
+            {
+                stream << sample;
+            }
+            else
+            {
+                stream << "null";
+            }
+        }
+        stream << "]";
+    };
+
+    uint64_t first = frame >= historySize ? frame - historySize + 1 : 0;
+    stream << "{\n  \"firstFrame\": " << first << ",\n  \"frame\": ";
+    writePercentiles(getFramePercentiles());
+    stream << ",\n  \"frameTimes\": ";
+    writeSamples(frameTimes, first, frame);
+    stream << ",\n  \"phases\": [";
+    for (size_t i = 0; i < phases.size(); i++)
+    {
+        const Phase &phase = phases[i];
+        stream << (i ? "," : "") << "\n    {\"name\": \"" << phase.name << "\", \"cpu\": ";
+        writePercentiles(computePercentiles(phase.cpu));
+        stream << ", \"gpu\": ";
+        writePercentiles(computePercentiles(phase.gpu));
+        stream << ",\n     \"cpuTimes\": ";
+        writeSamples(phase.cpu, first, frame);
+        stream << ",\n     \"gpuTimes\": ";
+        writeSamples(phase.gpu, first, frame);
+        stream << "}";
+    }
+    stream << "\n  ]\n}\n";
+}
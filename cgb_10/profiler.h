@@ -0,0 +1,120 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#define GLFW_INCLUDE_GLEXT
+
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Measures the CPU and GPU time of named phases of a frame and keeps the
+ * last historySize frames for percentiles.
+ *
+ * Phases are measured with Profiler::Scope and may nest. The GPU time comes
+ * from timestamp queries, whose results are collected a few frames later so
+ * the CPU never waits for them. Without timer queries only CPU times are
+ * recorded. Meant for the render thread only.
+ */
+class Profiler
+{
+  public:
+    static constexpr size_t historySize = 600;
+
+    struct Percentiles
+    {
+        double p50;
+        double p95;
+        double p99;
+        double max;
+        size_t samples;
+    };
+
+    /**
+     * Measures the phase with the given name until the end of the scope.
+     * The name has to stay valid for the lifetime of the program.
+     */
+    class Scope
+    {
+      public:
+        Scope(const char *name);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+      private:
+        uint32_t phase;
+        uint32_t query;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    static void beginFrame();
+    static Percentiles getFramePercentiles();
+    static Percentiles getPercentiles(const std::string &phase, bool gpu);
+    static void printReport(std::ostream &stream);
+    static void save(const std::string &filename);
+
+  private:
+    static constexpr uint32_t noQuery = UINT32_MAX;
+    static constexpr int queryLatency = 4;
+
+    struct Phase
+    {
+        const char *name;
+        std::vector<float> cpu;
+        std::vector<float> gpu;
+    };
+
+    struct PendingQuery
+    {
+        uint32_t phase;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    struct QueryFrame
+    {
+        uint64_t frame;
+        std::vector<GLuint> queries;
+        std::vector<PendingQuery> pending;
+        uint32_t used;
+    };
+
+    static uint32_t getPhase(const char *name);
+    static uint32_t beginQuery();
+    static void endQuery(uint32_t phase, uint32_t begin);
+    static uint32_t issueQuery(QueryFrame &queryFrame);
+    static void collectQueries(QueryFrame &queryFrame);
+    static void add(std::vector<float> &samples, uint64_t frame, double milliseconds);
+    static Percentiles computePercentiles(const std::vector<float> &samples);
+    static void writeCsv(std::ostream &stream);
+    static void writeJson(std::ostream &stream);
+
+    static inline std::vector<Phase> phases;
+    static inline std::vector<float> frameTimes = std::vector<float>(historySize, -1.0f);
+    static inline uint64_t frame = 0;
+    static inline std::chrono::steady_clock::time_point frameStart = {};
+    static inline QueryFrame queryFrames[queryLatency] = {};
+    static inline int timerQueries = -1;
+};
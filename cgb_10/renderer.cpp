@@ -20,14 +20,30 @@
 #include "renderer.h"
 
 #include "cube.h"
+#include "extensions.h"
+#include "geometrycache.h"
+#include "instancedmesh.h"
 #include "planet.h"
+#include "profiler.h"
+#include "renderqueue.h"
+#include "renderstate.h"
 #include "scene.h"
 #include "simulation.h"
 #include "skybox.h"
 #include "sphere.h"
+#include "textureloader.h"
+#include "trace.h"
+#include "virtualtexture.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
+#include <vector>
 
 namespace Colors
 {
@@ -36,22 +52,81 @@ namespace Colors
     Color ambientLight = Color(0.05, 0.05, 0.05, 1.0);
     Color sky = Color(0.5, 0.5, 0.5, 1.0);
     Color black = Color(0.0, 0.0, 0.0, 1.0);
+    Color ocean = Color(0.05, 0.1, 0.25, 1.0);
 }
 
-Renderer::Renderer(const std::string &title, uint32_t width, uint32_t height)
+static const char *getPlanetShadingName(PlanetShading shading)
+{
+    switch (shading)
+    {
+        case PlanetShading::SinglePass:
+            return "single pass";
+        case PlanetShading::Combiners:
+            return "texture combiners";
+        case PlanetShading::MultiPass:
+            return "five passes";
+    }
+    return "unknown";
+}
+
+/**
+ * True unless this is Linux without an X11 or Wayland display, e.g. a build
+ * server. Other systems always have a window system.
+ */
+static bool hasDisplay()
+{
+#if defined(__linux__)
+    return std::getenv("DISPLAY") || std::getenv("WAYLAND_DISPLAY");
+#else
+    return true;
+#endif
+}
+
+/**
+ * Opens the window and sets up the OpenGL state.
+ *
+ * @param headless Renders into an offscreen framebuffer of the given size
+ *                 instead, with an invisible window or, without a display,
+ *                 on GLFW's null platform with an EGL or OSMesa context.
+ */
+Renderer::Renderer(const std::string &title, uint32_t width, uint32_t height, bool headless)
+    : headless(headless)
 {
     glfwSetErrorCallback([](int error, const char *description)
     {
         std::cerr << "GLFW Error: " << description << std::endl;
     });
 
+    bool nullPlatform = headless && !hasDisplay() && glfwPlatformSupported(GLFW_PLATFORM_NULL);
+    if (nullPlatform)
+    {
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    }
+
     if (!glfwInit())
     {
         throw std::runtime_error("Failed to initialize GLFW");
     }
-    glfwWindowHint(GLFW_SAMPLES, 4);
+
+    if (headless)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
+    else
+    {
+        glfwWindowHint(GLFW_SAMPLES, 4);
+    }
+    if (nullPlatform)
+    {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    }
 
     window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+    if (!window && nullPlatform)
+    {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+    }
     if (!window)
     {
         glfwTerminate();
@@ -59,11 +134,24 @@ Renderer::Renderer(const std::string &title, uint32_t width, uint32_t height)
     }
 
     glfwMakeContextCurrent(window);
+    GL::loadExtensions();
+    RenderState::invalidate();
+    if (headless)
+    {
+        createOffscreenFramebuffer(width, height);
+    }
+    if (!GL::hasVertexBuffers())
+    {
+        Geometry::setRenderMode(RenderMode::Immediate);
+    }
+    Planet::setShading(Planet::isSupported(PlanetShading::SinglePass) ? PlanetShading::SinglePass : PlanetShading::Combiners);
+
     glfwSetWindowUserPointer(window, this);
     glfwSetKeyCallback(window, [](GLFWwindow *window, int key, int scancode, int action, int mods)
     {
         Renderer *self = static_cast<Renderer *>(glfwGetWindowUserPointer(window));
-        self->onKeyboardInput(window, key, scancode, action, mods);
+        InputEvent event = {InputType::Key, static_cast<uint8_t>(action), static_cast<uint16_t>(mods), key, 0.0, 0.0};
+        self->onInput(event, true);
     });
     glfwSetFramebufferSizeCallback(window, [](GLFWwindow *w, int width, int height)
     {
@@ -83,69 +171,133 @@ Renderer::Renderer(const std::string &title, uint32_t width, uint32_t height)
     glLightModelfv(GL_LIGHT_MODEL_AMBIENT, noLight);
 
     glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ZERO);
+    RenderState::setBlendFunc(GL_ONE, GL_ZERO);
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    if (glfwRawMouseMotionSupported())
+    if (!headless)
+    {
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
+    if (!headless && glfwRawMouseMotionSupported())
     {
         glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
     }
 
-    double mousePositionX, mousePositionY;
-    glfwGetCursorPos(window, &mousePositionX, &mousePositionY);
-    activeCamera.changePosition(mousePositionX, mousePositionY);
+    glfwGetCursorPos(window, &initialCursorX, &initialCursorY);
+    activeCamera.changePosition(initialCursorX, initialCursorY);
     glfwSetCursorPosCallback(window, [](GLFWwindow *window, double x, double y)
     {
         Renderer *self = static_cast<Renderer *>(glfwGetWindowUserPointer(window));
-        self->activeCamera.changePosition(x, y);
+        self->onInput({InputType::CursorPosition, 0, 0, 0, x, y}, true);
     });
 
     glfwSetScrollCallback(window, [](GLFWwindow *window, double xOffset, double yOffset)
     {
         Renderer *self = static_cast<Renderer *>(glfwGetWindowUserPointer(window));
-        self->activeCamera.changeDistance(yOffset);
+        self->onInput({InputType::Scroll, 0, 0, 0, xOffset, yOffset}, true);
     });
 }
 
 Renderer::~Renderer()
 {
+    if (framebuffer)
+    {
+        GL::DeleteFramebuffers(1, &framebuffer);
+        GL::DeleteRenderbuffers(2, framebufferAttachments);
+    }
     glfwDestroyWindow(window);
     glfwTerminate();
 }
 
-void Renderer::start()
+/**
+ * Runs the main loop until the window is closed.
+ *
+ * @param frameLimit Stops after this many frames, unless zero.
+ * @param dumpDirectory Writes every frame as a PPM image to this directory, unless empty.
+ */
+void Renderer::start(uint32_t frameLimit, const std::string &dumpDirectory)
 {
-    auto starTexture = std::make_shared<Texture>("textures/cubemap8k.jpg");
+    TRACE_THREAD("render");
+    TRACE_ZONE("Renderer::start");
+    double launchTime = glfwGetTime();
+    GeometryCache::load(geometryCacheFile);
+
+    // Decoded in the background, meanwhile the meshes show a color close to the image
+    TextureLoader textureLoader;
+    auto starTexture = textureLoader.load("textures/cubemap8k.jpg", GL_RGB, Colors::black);
     auto noTexture = std::shared_ptr<Texture>{};
-    auto earthTexture = std::make_shared<Texture>("textures/earth_diffuse.jpg");
-    auto earthNightTexture = std::make_shared<Texture>("textures/earth_emission.jpg");
-    auto earthSpecularTexture = std::make_shared<Texture>("textures/earth_specular.jpg");
-    auto satelliteTexture = std::make_shared<Texture>("textures/thm2k.png");
+    std::shared_ptr<VirtualTexture> earthSurface;
+    std::shared_ptr<Planet> earth;
+    std::vector<VirtualTexture::Layer> earthLayers = {
+        {"textures/earth_diffuse.tiles", GL_RGB}, {"textures/earth_emission.tiles", GL_RGB}, {"textures/earth_specular.tiles", GL_INTENSITY}};
+    bool earthTiled = std::all_of(earthLayers.begin(), earthLayers.end(), [](const auto &layer) { return std::filesystem::exists(layer.filename); });
+    if (earthTiled && VirtualTexture::isSupported())
+    {
+        // Imagery cut into tiles by tilepack, which may be larger than any texture
+        earthSurface = std::make_shared<VirtualTexture>(earthLayers);
+        earth = std::make_shared<Planet>(earthSurface);
+    }
+    else
+    {
+        if (earthTiled) std::cerr << "Virtual textures not supported, loading the earth textures instead of the tiles" << std::endl;
+        auto earthTexture = textureLoader.load("textures/earth_diffuse.jpg", GL_RGB, Colors::ocean);
+        auto earthNightTexture = textureLoader.load("textures/earth_emission.jpg", GL_RGB, Colors::black);
+        auto earthSpecularTexture = textureLoader.load("textures/earth_specular.jpg", GL_INTENSITY, Colors::black);
+        earth = std::make_shared<Planet>(earthTexture, earthSpecularTexture, earthNightTexture);
+    }
+    auto satelliteTexture = textureLoader.load("textures/thm2k.png", GL_RGB, Colors::sky);
 
     auto stars = std::make_shared<Skybox>(starTexture);
     auto sun = std::make_shared<Sphere>(noTexture);
-    auto earth = std::make_shared<Planet>(earthTexture, earthSpecularTexture, earthNightTexture);
     auto satellite = std::make_shared<Cube>(satelliteTexture);
+    auto earthFrame = std::make_shared<Transform>();
+    auto satelliteOrbit = std::make_shared<Transform>();
+    auto constellation = std::make_shared<InstancedMesh>(satelliteTexture, satellite->getGeometry());
+
+    GeometryCache::save(geometryCacheFile);
+    std::cout << "Geometry: " << GeometryCache::getGeneratedCount() << " generated, " << GeometryCache::getMappedCount() << " from cache" << std::endl;
+
+    stars->upload();
+    sun->upload();
+    earth->upload();
+    satellite->upload();
 
     satellite->setScale(0.01);
     satellite->setMaterial(Colors::black, Colors::black, Colors::white, Colors::black, 0.0f);
 
+    constellation->setInstanceCount(constellationSize);
+    constellation->setMaterial(Colors::white, Colors::black, Colors::black, Colors::white, 0.0f);
+
     stars->setScale(5);
     sun->setScale(0.03);
     sun->setPosition(Vector3(0, 0, 3));
     sun->setMaterial(Colors::black, Colors::black, Colors::white, Colors::black, 0.0f);
 
-    Scene background;
+    Scene background("background");
     background.addMesh(stars);
     background.addMesh(sun);
     background.enableDepthIsolation();
     background.enableFixedPosition();
 
-    Scene foreground;
-    foreground.addMesh(earth);
-    foreground.addMesh(satellite);
+    // The earth spins inside its frame, the orbit of the satellite does not
+    Scene foreground("foreground");
+    Scene::NodeId earthNode = foreground.addNode(earthFrame);
+    foreground.addMesh(earth, earthNode);
+    Scene::NodeId orbitNode = foreground.addNode(satelliteOrbit, earthNode);
+    foreground.addMesh(satellite, orbitNode);
+    foreground.addMesh(constellation, earthNode);
 
-    Simulation simulation(earth, satellite);
+    Simulation simulation(earth, satelliteOrbit, satellite, constellation);
+
+    // A replay starts from the camera the recording started from, wherever the cursor is now
+    if (replaying)
+    {
+        activeCamera = initialCamera;
+        activeCamera.changePosition(replaying->getCursorX(), replaying->getCursorY());
+    }
+    if (!recordingFile.empty())
+    {
+        recording = std::make_unique<InputRecording>(initialCursorX, initialCursorY);
+    }
 
     setViewportSize();
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
@@ -154,21 +306,184 @@ void Renderer::start()
     foreground.setLight(lightPosition, Colors::sunLight, Colors::ambientLight, Colors::white);
     background.setLight(lightPosition, Colors::black, Colors::sky, Colors::black);
 
-    while (!glfwWindowShouldClose(window))
+    // Headless runs step the simulation by the frame count, so the same frames come out on every machine.
+    // Recordings and replays step it once per frame at the recorded time instead of on its own thread.
+    bool simulationThread = !headless && !recording && !replaying;
+    if (simulationThread)
+    {
+        simulation.start(simulationRate);
+    }
+    if (!dumpDirectory.empty())
+    {
+        std::filesystem::create_directories(dumpDirectory);
+    }
+
+    // Frames that have to come out the same every time do not show placeholders
+    if (!simulationThread)
+    {
+        textureLoader.finish();
+    }
+
+    RenderQueue queue;
+    uint32_t frame = 0;
+    double startTime = glfwGetTime();
+    while (!glfwWindowShouldClose(window) && (frameLimit == 0 || frame < frameLimit))
     {
-        simulation.update();
+        if (replaying && frame >= replaying->getFrameCount()) break;
+
+        TRACE_ZONE("frame");
+        Profiler::beginFrame();
+        Sphere::resetStatistics();
+        Scene::resetStatistics();
+        RenderState::resetStatistics();
+        {
+            Profiler::Scope scope("simulation");
+            if (simulationThread)
+            {
+                simulation.apply();
+            }
+            else
+            {
+                double time = headless ? headlessStartTime + frame * headlessFrameTime : Simulation::now();
+                if (replaying) time = replaying->getTime(frame);
+                if (recording) recording->beginFrame(time);
+                simulation.update(time);
+            }
+        }
+        {
+            Profiler::Scope scope("scene update");
+            background.update();
+            foreground.update();
+        }
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        background.render(activeCamera);
-        foreground.render(activeCamera);
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-        printFps();
+        {
+            Profiler::Scope scope("submit");
+            queue.clear();
+            background.submit(queue, activeCamera);
+            foreground.submit(queue, activeCamera);
+        }
+        queue.execute();
+        if (!dumpDirectory.empty())
+        {
+            std::ostringstream filename;
+            filename << dumpDirectory << "/frame" << std::setw(5) << std::setfill('0') << frame << ".ppm";
+            writeFrame(filename.str());
+        }
+        {
+            Profiler::Scope scope("swap");
+            glfwSwapBuffers(window);
+        }
+        if (frame == 0)
+        {
+            std::cout << "First frame after " << (glfwGetTime() - launchTime) * 1000.0 << " ms" << std::endl;
+        }
+        if (textureLoader.getPendingCount() > 0)
+        {
+            Profiler::Scope scope("textures");
+            textureLoader.update(textureUploadBudget);
+            if (textureLoader.getPendingCount() == 0)
+            {
+                std::cout << "Textures loaded after " << (glfwGetTime() - launchTime) * 1000.0 << " ms" << std::endl;
+            }
+        }
+        if (earthSurface)
+        {
+            // Frames that have to come out the same load all tiles the frame asked for before the next one
+            Profiler::Scope scope("tiles");
+            if (simulationThread)
+            {
+                earthSurface->update(tileUploadBudget);
+            }
+            else
+            {
+                earthSurface->finish();
+            }
+        }
+        {
+            Profiler::Scope scope("events");
+            glfwPollEvents();
+            if (replaying)
+            {
+                for (const InputEvent &event : replaying->getEvents(frame))
+                {
+                    onInput(event, false);
+                }
+            }
+        }
+        printStatistics();
+        frame++;
         if (resized)
         {
             resized = false;
             setViewportSize();
         }
     }
+
+    if (recording)
+    {
+        recording->save(recordingFile);
+        std::cout << "Recorded " << recording->getFrameCount() << " frames to " << recordingFile << std::endl;
+        recording.reset();
+    }
+    if (headless || replaying)
+    {
+        glFinish();
+        double time = (glfwGetTime() - startTime) * 1000.0;
+        std::cout << (replaying ? "Replay: " : "Headless: ") << frame << " frames in " << time << " ms, " << time / std::max(frame, 1u) << " ms/frame" << std::endl;
+    }
+}
+
+/**
+ * Records the input events of every frame of the next start() in a file.
+ */
+void Renderer::record(const std::string &filename)
+{
+    recordingFile = filename;
+}
+
+/**
+ * Makes the next start() replay a recording instead of following the live
+ * input and clock, and stop at its end.
+ */
+void Renderer::replay(const std::string &filename)
+{
+    replaying = std::make_unique<InputRecording>(filename);
+}
+
+/**
+ * Sets the fixed rate at which the next start() steps the simulation on its
+ * own thread. Headless runs, recordings and replays step once per frame.
+ */
+void Renderer::setSimulationRate(double stepsPerSecond)
+{
+    if (!(stepsPerSecond > 0.0))
+    {
+        throw std::invalid_argument("Simulation rate must be positive");
+    }
+    simulationRate = stepsPerSecond;
+}
+
+/**
+ * Handles an input event from GLFW or from a replay. During a replay live
+ * events are ignored, except for escape, so the replay can be cancelled.
+ */
+void Renderer::onInput(const InputEvent &event, bool live)
+{
+    if (live && replaying && !(event.type == InputType::Key && event.key == GLFW_KEY_ESCAPE)) return;
+    if (live && recording) recording->addEvent(event);
+
+    switch (event.type)
+    {
+        case InputType::CursorPosition:
+            activeCamera.changePosition(event.x, event.y);
+            break;
+        case InputType::Scroll:
+            activeCamera.changeDistance(event.y);
+            break;
+        case InputType::Key:
+            onKeyboardInput(window, event.key, 0, event.action, event.mods);
+            break;
+    }
 }
 
 void Renderer::onKeyboardInput(GLFWwindow *window, int key, int scancode, int action, int mods)
@@ -188,15 +503,246 @@ void Renderer::onKeyboardInput(GLFWwindow *window, int key, int scancode, int ac
             glfwMaximizeWindow(window);
         }
     }
+    else if (key == GLFW_KEY_P && action == GLFW_PRESS)
+    {
+        PlanetShading shading = Planet::getShading();
+        do
+        {
+            shading = static_cast<PlanetShading>((static_cast<int>(shading) + 1) % 3);
+        } while (!Planet::isSupported(shading));
+        Planet::setShading(shading);
+        std::cout << "Planet shading: " << getPlanetShadingName(shading) << std::endl;
+    }
+    else if (key == GLFW_KEY_F && action == GLFW_PRESS)
+    {
+        Profiler::printReport(std::cout);
+        Profiler::save(profileFile + ".csv");
+        Profiler::save(profileFile + ".json");
+        std::cout << "Profile written to " << profileFile << ".csv and " << profileFile << ".json" << std::endl;
+    }
+    else if (key == GLFW_KEY_V && action == GLFW_PRESS)
+    {
+        if (Geometry::getRenderMode() == RenderMode::VertexBuffer)
+        {
+            Geometry::setRenderMode(RenderMode::Immediate);
+            std::cout << "Render mode: immediate" << std::endl;
+        }
+        else if (GL::hasVertexBuffers())
+        {
+            Geometry::setRenderMode(RenderMode::VertexBuffer);
+            std::cout << "Render mode: vertex buffer" << std::endl;
+        }
+    }
+}
+
+/**
+ * Draws a grid of satellites once as individual meshes and once as a single
+ * instanced mesh and prints the time per frame of both. The instance buffer
+ * is rewritten every frame, as it would be for a moving constellation.
+ */
+void Renderer::benchmarkInstancing()
+{
+    const size_t count = 10000;
+    const int frames = 200;
+    const size_t columns = 100;
+    const double spacing = 0.03;
+
+    glfwSwapInterval(0);
+    setViewportSize();
+
+    auto noTexture = std::shared_ptr<Texture>{};
+    auto prototype = std::make_shared<Cube>(noTexture);
+    prototype->upload();
+
+    auto constellation = std::make_shared<InstancedMesh>(noTexture, prototype->getGeometry());
+    constellation->setInstanceCount(count);
+
+    Scene individual;
+    Scene instanced;
+    instanced.addMesh(constellation);
+    for (size_t i = 0; i < count; i++)
+    {
+        double x = (static_cast<double>(i % columns) - columns * 0.5) * spacing;
+        double y = (static_cast<double>(i / columns) - columns * 0.5) * spacing;
+
+        auto mesh = std::make_shared<Cube>(noTexture);
+        mesh->setPosition(Vector3(x, y, 0.0));
+        mesh->setScale(spacing * 0.3);
+        mesh->setMaterial(Colors::white, Colors::black, Colors::black, Colors::white, 0.0f);
+        individual.addMesh(mesh);
+
+        Matrix4 transform = Matrix4::translate(x, y, 0.0) * Matrix4::scale(spacing * 0.3);
+        constellation->setInstance(i, transform.as<float>(), Colorf{0.0f, 0.0f, 0.0f, 1.0f});
+    }
+    constellation->setMaterial(Colors::white, Colors::black, Colors::black, Colors::white, 0.0f);
+
+    Vector4 lightPosition(0, 0, 50000, 0);
+    individual.setLight(lightPosition, Colors::sunLight, Colors::ambientLight, Colors::white);
+    instanced.setLight(lightPosition, Colors::sunLight, Colors::ambientLight, Colors::white);
+
+    std::cout << "Instancing: " << (GL::hasInstancing() ? "supported" : "not supported, drawing instances one by one") << std::endl;
+
+    auto measure = [&](Scene &scene, bool rewriteInstances)
+    {
+        double start = 0.0;
+        for (int frame = -10; frame < frames; frame++)
+        {
+            if (frame == 0)
+            {
+                glFinish();
+                start = glfwGetTime();
+            }
+            if (rewriteInstances) constellation->editInstances();
+            Scene::resetStatistics();
+            scene.update();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            scene.render(activeCamera);
+            glfwSwapBuffers(window);
+        }
+        glFinish();
+        return (glfwGetTime() - start) * 1000.0 / frames;
+    };
+
+    double individualTime = measure(individual, false);
+    uint32_t individualDrawn = Scene::getStatistics().drawn;
+    double instancedTime = measure(instanced, true);
+
+    std::cout << count << " satellites, " << frames << " frames" << std::endl;
+    std::cout << "  individual meshes: " << individualTime << " ms/frame (" << individualDrawn << " draw calls)" << std::endl;
+    std::cout << "  instanced mesh:    " << instancedTime << " ms/frame (" << (GL::hasInstancing() ? "1 draw call" : "fallback") << ")" << std::endl;
+    std::cout << "  speedup:           " << individualTime / instancedTime << "x" << std::endl;
 }
 
-void Renderer::printFps()
+/**
+ * Renders the earth from several directions with the five fixed-function
+ * passes and with every faster planet shading path the context supports,
+ * reads back the frames and compares them. The faster paths light per
+ * fragment or look the lighting up in a texture where the five passes light
+ * per vertex, so small differences are expected along the terminator and in
+ * the specular highlight. Both paths share one tolerance, which the shader
+ * path needs; the combiner path stays well within it.
+ *
+ * @return True if every view stays within the tolerance.
+ */
+bool Renderer::comparePlanetShading()
+{
+    const double maxMeanDifference = 2.0;
+    const double maxOutlierShare = 0.01;
+    const int outlierThreshold = 24;
+    const double views[][2] = {{0.0, 0.0}, {20.0, 60.0}, {-30.0, 110.0}, {0.0, 180.0}, {45.0, 300.0}};
+    const PlanetShading candidates[] = {PlanetShading::Combiners, PlanetShading::SinglePass};
+
+    PlanetShading previousShading = Planet::getShading();
+    glfwSwapInterval(0);
+    int width, height;
+    getFramebufferSize(width, height);
+    glViewport(0, 0, width, height);
+
+    auto earthTexture = std::make_shared<Texture>("textures/earth_diffuse.jpg");
+    auto earthNightTexture = std::make_shared<Texture>("textures/earth_emission.jpg");
+    auto earthSpecularTexture = std::make_shared<Texture>("textures/earth_specular.jpg", GL_INTENSITY);
+    auto earth = std::make_shared<Planet>(earthTexture, earthSpecularTexture, earthNightTexture);
+    earth->upload();
+
+    Scene scene;
+    scene.addMesh(earth);
+    Vector4 lightPosition(0, 0, 50000, 0);
+    scene.setLight(lightPosition, Colors::sunLight, Colors::ambientLight, Colors::white);
+
+    size_t size = static_cast<size_t>(width) * height * 3;
+    std::vector<uint8_t> reference(size);
+    std::vector<uint8_t> image(size);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    auto capture = [&](const Camera &camera, PlanetShading shading, std::vector<uint8_t> &pixels)
+    {
+        Planet::setShading(shading);
+        scene.update();
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        scene.render(camera);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+        glfwSwapBuffers(window);
+    };
+
+    bool passed = true;
+    for (PlanetShading shading : candidates)
+    {
+        if (!Planet::isSupported(shading))
+        {
+            std::cout << "Planet shading: " << getPlanetShadingName(shading) << " not supported, skipped" << std::endl;
+            continue;
+        }
+
+        bool shadingPassed = true;
+        for (const auto &view : views)
+        {
+            Camera camera(view[0], view[1], 3.0);
+            camera.setViewport(width, height);
+            camera.loadProjectionMatrix();
+
+            capture(camera, PlanetShading::MultiPass, reference);
+            capture(camera, shading, image);
+
+            uint64_t sum = 0;
+            size_t outliers = 0;
+            int maxDifference = 0;
+            for (size_t i = 0; i < size; i++)
+            {
+                int difference = std::abs(static_cast<int>(reference[i]) - static_cast<int>(image[i]));
+                sum += difference;
+                if (difference > outlierThreshold) outliers++;
+                maxDifference = std::max(maxDifference, difference);
+            }
+            double meanDifference = static_cast<double>(sum) / size;
+            double outlierShare = static_cast<double>(outliers) / size;
+            bool viewPassed = meanDifference <= maxMeanDifference && outlierShare <= maxOutlierShare;
+            shadingPassed = shadingPassed && viewPassed;
+
+            std::cout << "  pitch " << view[0] << ", yaw " << view[1] << ": mean difference " << meanDifference
+                      << ", max " << maxDifference << ", " << outlierShare * 100.0 << "% above " << outlierThreshold
+                      << (viewPassed ? "" : " FAILED") << std::endl;
+        }
+        std::cout << "Planet shading: " << getPlanetShadingName(shading) << (shadingPassed ? " matches" : " differs from")
+                  << " five passes" << std::endl;
+        passed = passed && shadingPassed;
+    }
+
+    Planet::setShading(previousShading);
+    return passed;
+}
+
+/**
+ * Prints the frame rate, the frame time percentiles and the statistics of
+ * the last frame once per second.
+ */
+void Renderer::printStatistics()
 {
     double currentTime = glfwGetTime();
     if (currentTime - previousTime >= 1.0)
     {
         uint32_t fps = frameCount;
-        std::cout << "FPS: " << fps << std::endl;
+        Profiler::Percentiles frameTime = Profiler::getFramePercentiles();
+        std::ostringstream frameTimes;
+        frameTimes << std::fixed << std::setprecision(1) << frameTime.p50 << " ms p50, " << frameTime.p95 << " p95, "
+                   << frameTime.p99 << " p99, " << frameTime.max << " max";
+        std::cout << "FPS: " << fps << " | Frame: " << frameTimes.str() << " | Sphere levels:";
+        const auto &levels = Sphere::getStatistics();
+        for (size_t i = 0; i < levels.size(); i++)
+        {
+            if (levels[i]) std::cout << " L" << i << "x" << levels[i];
+        }
+        const auto &scene = Scene::getStatistics();
+        const auto &state = RenderState::getStatistics();
+        std::cout << " | World matrices: " << scene.reused << " cached, " << scene.computed << " computed"
+                  << " | Meshes: " << scene.drawn << " drawn, " << scene.culled << " culled"
+                  << " | State changes: " << state.issued << " issued, " << state.skipped << " skipped";
+        const auto &tiles = VirtualTexture::getStatistics();
+        if (tiles.resident)
+        {
+            std::cout << " | Tiles: " << tiles.resident << " resident, " << tiles.pending << " pending";
+        }
+        std::cout << std::endl;
 
         frameCount = 0;
         previousTime = currentTime;
@@ -205,10 +751,81 @@ void Renderer::printFps()
     frameCount++;
 }
 
+/**
+ * Renders into a framebuffer object instead of the window, which may not
+ * have a framebuffer at all without a display. Without framebuffer objects,
+ * the framebuffer of the invisible window is used.
+ */
+void Renderer::createOffscreenFramebuffer(int width, int height)
+{
+    if (!GL::hasFramebuffers())
+    {
+        std::cerr << "Framebuffer objects not supported, rendering to the window" << std::endl;
+        return;
+    }
+
+    GL::GenRenderbuffers(2, framebufferAttachments);
+    GL::BindRenderbuffer(GL_RENDERBUFFER, framebufferAttachments[0]);
+    GL::RenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    GL::BindRenderbuffer(GL_RENDERBUFFER, framebufferAttachments[1]);
+    GL::RenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    GL::BindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GL::GenFramebuffers(1, &framebuffer);
+    GL::BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    GL::FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, framebufferAttachments[0]);
+    GL::FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, framebufferAttachments[1]);
+    if (GL::CheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::runtime_error("Failed to create offscreen framebuffer");
+    }
+
+    framebufferWidth = width;
+    framebufferHeight = height;
+}
+
+void Renderer::getFramebufferSize(int &width, int &height) const
+{
+    if (framebuffer)
+    {
+        width = framebufferWidth;
+        height = framebufferHeight;
+        return;
+    }
+    glfwGetFramebufferSize(window, &width, &height);
+}
+
+/**
+ * Reads back the frame rendered so far and writes it as a binary PPM image.
+ */
+void Renderer::writeFrame(const std::string &filename) const
+{
+    int width, height;
+    getFramebufferSize(width, height);
+    size_t rowSize = static_cast<size_t>(width) * 3;
+    std::vector<uint8_t> pixels(rowSize * height);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write frame: " + filename);
+    }
+
+    // OpenGL returns the bottom row first
+    file << "P6\n" << width << " " << height << "\n255\n";
+    for (int y = height - 1; y >= 0; y--)
+    {
+        file.write(reinterpret_cast<const char *>(pixels.data() + y * rowSize), rowSize);
+    }
+}
+
 void Renderer::setViewportSize()
 {
     int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
+    getFramebufferSize(width, height);
     glViewport(0, 0, width, height);
-    activeCamera.loadProjectionMatrix(width / static_cast<double>(height));
+    activeCamera.setViewport(width, height);
+    activeCamera.loadProjectionMatrix();
 }
\ No newline at end of file
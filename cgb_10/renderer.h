@@ -22,26 +22,57 @@
 #define GLFW_INCLUDE_GLEXT
 
 #include "camera.h"
+#include "inputrecording.h"
 
 #include <GLFW/glfw3.h>
+#include <memory>
 #include <string>
 
 class Renderer
 {
   public:
-    Renderer(const std::string &title, uint32_t width, uint32_t height);
+    Renderer(const std::string &title, uint32_t width, uint32_t height, bool headless = false);
     ~Renderer();
-    void start();
-    void printFps();
+    void start(uint32_t frameLimit = 0, const std::string &dumpDirectory = "");
+    void record(const std::string &filename);
+    void replay(const std::string &filename);
+    void setSimulationRate(double stepsPerSecond);
+    void benchmarkInstancing();
+    bool comparePlanetShading();
+    void printStatistics();
     void onKeyboardInput(GLFWwindow *window, int key, int scancode, int action, int mods);
+    void onInput(const InputEvent &event, bool live);
 
   private:
     GLFWwindow *window = nullptr;
     bool resized = false;
-    Camera activeCamera = Camera(0.0, 0.0, 5.0);
+    bool headless = false;
+    GLuint framebuffer = 0;
+    GLuint framebufferAttachments[2] = {0, 0};
+    int framebufferWidth = 0;
+    int framebufferHeight = 0;
+    const Camera initialCamera = Camera(0.0, 0.0, 5.0);
+    Camera activeCamera = initialCamera;
+    double initialCursorX = 0.0;
+    double initialCursorY = 0.0;
+    std::string recordingFile;
+    std::unique_ptr<InputRecording> recording;
+    std::unique_ptr<InputRecording> replaying;
     double previousTime = 0.0;
     uint32_t frameCount = 0;
-    uint32_t fps = 0;
+    const std::string geometryCacheFile = "geometry.cache";
+    const std::string profileFile = "profile";
+    const size_t constellationSize = 2400;
+    double simulationRate = 120.0;
+    const double textureUploadBudget = 0.004;
+    const double tileUploadBudget = 0.002;
 
+    // Headless runs start at 2024-03-20 12:00 UTC and advance by a fixed time per frame
+    const double headlessStartTime = 1710936000.0;
+    const double headlessFrameTime = 1.0 / 60.0;
+
+    void createOffscreenFramebuffer(int width, int height);
+    void getFramebufferSize(int &width, int &height) const;
+    void writeFrame(const std::string &filename) const;
     void setViewportSize();
 };
\ No newline at end of file
@@ -0,0 +1,153 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "renderqueue.h"
+
+#include "mesh.h"
+#include "profiler.h"
+#include "trace.h"
+
+#include <bit>
+#include <stdexcept>
+
+namespace
+{
+    constexpr int layerBits = 8;
+    constexpr int blendBits = 2;
+    constexpr int textureBits = 16;
+    constexpr int materialBits = 16;
+    constexpr int distanceBits = 22;
+    static_assert(layerBits + blendBits + textureBits + materialBits + distanceBits == 64);
+
+    constexpr uint64_t mask(int bits)
+    {
+        return (uint64_t(1) << bits) - 1;
+    }
+}
+
+/**
+ * Adds a layer that is drawn after all previously added ones.
+ *
+ * @param name Profiler phase of the layer, has to stay valid for the lifetime of the program.
+ * @param begin Called before the first mesh of the layer, e.g. to load the view matrix.
+ * @param end Called after the last mesh of the layer.
+ * @return The layer to pass to submit().
+ */
+uint32_t RenderQueue::addLayer(const char *name, std::function<void()> begin, std::function<void()> end)
+{
+    if (layers.size() > mask(layerBits)) throw std::length_error("Too many render queue layers");
+    layers.push_back({name, std::move(begin), std::move(end)});
+    return static_cast<uint32_t>(layers.size() - 1);
+}
+
+/**
+ * Queues a mesh for drawing with the given world matrix, which has to stay
+ * valid until execute().
+ *
+ * @param distance Distance of the mesh to the camera, used for the drawing order within the layer.
+ */
+void RenderQueue::submit(uint32_t layer, const Mesh &mesh, const Matrix4f &worldMatrix, float distance)
+{
+    uint32_t blendMode = static_cast<uint32_t>(mesh.getBlendMode());
+    items.push_back({makeKey(layer, blendMode, mesh.getTextureId(), mesh.getMaterialId(), distance), &mesh, &worldMatrix});
+}
+
+/**
+ * Sorts the queued meshes and draws them layer by layer. Layers without
+ * meshes are still begun and ended, so their side effects stay in order.
+ */
+void RenderQueue::execute()
+{
+    TRACE_ZONE("RenderQueue::execute");
+    sort();
+
+    size_t next = 0;
+    for (uint32_t layer = 0; layer < layers.size(); layer++)
+    {
+        Profiler::Scope scope(layers[layer].name);
+        TRACE_ZONE(layers[layer].name);
+        layers[layer].begin();
+        for (; next < items.size() && (items[next].key >> (64 - layerBits)) == layer; next++)
+        {
+            items[next].mesh->render(*items[next].worldMatrix);
+        }
+        layers[layer].end();
+    }
+}
+
+void RenderQueue::clear()
+{
+    layers.clear();
+    items.clear();
+}
+
+/**
+ * Packs the sort key, a blend mode of zero is opaque. Textures and
+ * materials are reduced to their low bits, which only makes the grouping
+ * less strict when ids collide. Distances are quantized through their
+ * floating point representation, which keeps them ordered with a resolution
+ * relative to their size.
+ */
+uint64_t RenderQueue::makeKey(uint32_t layer, uint32_t blendMode, uint32_t texture, uint32_t material, float distance)
+{
+    // Non-negative floats order like their bit patterns, drop the sign and keep the upper bits
+    uint32_t distanceKey = std::bit_cast<uint32_t>(distance > 0.0f ? distance : 0.0f) >> (31 - distanceBits);
+
+    uint64_t key = uint64_t(layer & mask(layerBits)) << (64 - layerBits);
+    if (blendMode == 0)
+    {
+        key |= uint64_t(texture & mask(textureBits)) << (materialBits + distanceBits);
+        key |= uint64_t(material & mask(materialBits)) << distanceBits;
+        key |= distanceKey & mask(distanceBits);
+        return key;
+    }
+
+    // Back to front, the distance takes precedence over the state
+    uint64_t inverted = mask(distanceBits) - (distanceKey & mask(distanceBits));
+    key |= uint64_t(blendMode & mask(blendBits)) << (64 - layerBits - blendBits);
+    key |= inverted << (textureBits + materialBits);
+    key |= uint64_t(texture & mask(textureBits)) << materialBits;
+    key |= material & mask(materialBits);
+    return key;
+}
+
+/**
+ * Least significant digit radix sort on bytes. Passes where all keys share
+ * the same byte are skipped, which is the common case for the layer and
+ * blend bits.
+ */
+void RenderQueue::sort()
+{
+    sorted.resize(items.size());
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t counts[256] = {};
+        for (const Item &item : items) counts[(item.key >> shift) & 0xFF]++;
+        if (counts[(items.empty() ? 0 : items[0].key >> shift) & 0xFF] == items.size()) continue;
+
+        size_t offset = 0;
+        for (size_t &count : counts)
+        {
+            size_t start = offset;
+            offset += count;
+            count = start;
+        }
+        for (const Item &item : items) sorted[counts[(item.key >> shift) & 0xFF]++] = item;
+        items.swap(sorted);
+    }
+}
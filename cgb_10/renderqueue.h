@@ -0,0 +1,72 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "cgmath.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class Mesh;
+
+/**
+ * Collects the meshes of a frame with a 64-bit sort key each, sorts them
+ * with a radix sort and draws them in key order.
+ *
+ * From the most to the least significant bits a key holds the layer, the
+ * blend mode, the texture, the material and the distance to the camera, so
+ * state changes are grouped and opaque meshes are drawn front to back.
+ * Blended meshes come after the opaque ones of their layer and are drawn
+ * back to front instead.
+ *
+ * A layer is drawn completely before the next one and brackets its meshes
+ * with a begin and an end function, see Scene::submit().
+ */
+class RenderQueue
+{
+  public:
+    struct Item
+    {
+        uint64_t key;
+        const Mesh *mesh;
+        const Matrix4f *worldMatrix;
+    };
+
+    uint32_t addLayer(const char *name, std::function<void()> begin, std::function<void()> end);
+    void submit(uint32_t layer, const Mesh &mesh, const Matrix4f &worldMatrix, float distance);
+    void execute();
+    void clear();
+
+    static uint64_t makeKey(uint32_t layer, uint32_t blendMode, uint32_t texture, uint32_t material, float distance);
+
+  private:
+    struct Layer
+    {
+        const char *name;
+        std::function<void()> begin;
+        std::function<void()> end;
+    };
+
+    void sort();
+
+    std::vector<Layer> layers;
+    std::vector<Item> items;
+    std::vector<Item> sorted;
+};
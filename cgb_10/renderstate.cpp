@@ -0,0 +1,208 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "renderstate.h"
+
+#include "extensions.h"
+
+#include <algorithm>
+#include <iterator>
+
+void RenderState::setActiveTexture(GLenum unit)
+{
+    if (unit == activeTexture)
+    {
+        statistics.skipped++;
+        return;
+    }
+    GL::ActiveTexture(unit);
+    activeTexture = unit;
+    statistics.issued++;
+}
+
+/**
+ * Binds a 2D texture to the active texture unit, 0 unbinds.
+ */
+void RenderState::bindTexture(GLuint texture)
+{
+    int unit = activeTexture == unknown ? 0 : static_cast<int>(activeTexture - GL_TEXTURE0);
+    if (unit < maxTextureUnits)
+    {
+        if (texturesValid[unit] && textures[unit] == texture)
+        {
+            statistics.skipped++;
+            return;
+        }
+        textures[unit] = texture;
+        texturesValid[unit] = true;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    statistics.issued++;
+}
+
+/**
+ * Sets a color of the front and back material, the value has four components.
+ */
+void RenderState::setMaterial(GLenum name, const float *value)
+{
+    int index = getMaterialIndex(name);
+    if (index >= 0 && !change(material[index], value))
+    {
+        statistics.skipped++;
+        return;
+    }
+    glMaterialfv(GL_FRONT_AND_BACK, name, value);
+    statistics.issued++;
+}
+
+void RenderState::setShininess(float shininess)
+{
+    if (shininessValid && RenderState::shininess == shininess)
+    {
+        statistics.skipped++;
+        return;
+    }
+    glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, shininess);
+    RenderState::shininess = shininess;
+    shininessValid = true;
+    statistics.issued++;
+}
+
+void RenderState::setBlendFunc(GLenum source, GLenum destination)
+{
+    if (source == blendSource && destination == blendDestination)
+    {
+        statistics.skipped++;
+        return;
+    }
+    glBlendFunc(source, destination);
+    blendSource = source;
+    blendDestination = destination;
+    statistics.issued++;
+}
+
+void RenderState::setLightEnabled(GLenum light, bool enabled)
+{
+    int index = static_cast<int>(light - GL_LIGHT0);
+    if (index >= 0 && index < maxLights)
+    {
+        if (lightsEnabled[index] == static_cast<int8_t>(enabled))
+        {
+            statistics.skipped++;
+            return;
+        }
+        lightsEnabled[index] = static_cast<int8_t>(enabled);
+    }
+
+    if (enabled)
+    {
+        glEnable(light);
+    }
+    else
+    {
+        glDisable(light);
+    }
+    statistics.issued++;
+}
+
+/**
+ * Sets a parameter of a light, the value has four components.
+ */
+void RenderState::setLight(GLenum light, GLenum name, const float *value)
+{
+    int lightIndex = static_cast<int>(light - GL_LIGHT0);
+    int nameIndex = getLightIndex(name);
+    if (lightIndex >= 0 && lightIndex < maxLights && nameIndex >= 0 && !change(lights[lightIndex][nameIndex], value))
+    {
+        statistics.skipped++;
+        return;
+    }
+    glLightfv(light, name, value);
+    statistics.issued++;
+}
+
+/**
+ * Forgets the shadow copy, so that the next call of every setter is issued.
+ */
+void RenderState::invalidate()
+{
+    activeTexture = unknown;
+    std::fill(std::begin(texturesValid), std::end(texturesValid), false);
+    for (CachedColor &color : material) color.valid = false;
+    shininessValid = false;
+    blendSource = unknown;
+    blendDestination = unknown;
+    std::fill(std::begin(lightsEnabled), std::end(lightsEnabled), -1);
+    for (auto &light : lights)
+    {
+        for (CachedColor &color : light) color.valid = false;
+    }
+}
+
+void RenderState::resetStatistics()
+{
+    statistics = {};
+}
+
+const RenderState::Statistics &RenderState::getStatistics()
+{
+    return statistics;
+}
+
+/**
+ * Stores the value in the cache and returns true if it differs from the
+ * cached one.
+ */
+bool RenderState::change(CachedColor &cached, const float *value)
+{
+    if (cached.valid && std::equal(value, value + 4, cached.value)) return false;
+    std::copy(value, value + 4, cached.value);
+    cached.valid = true;
+    return true;
+}
+
+int RenderState::getMaterialIndex(GLenum name)
+{
+    switch (name)
+    {
+        case GL_AMBIENT:
+            return 0;
+        case GL_DIFFUSE:
+            return 1;
+        case GL_SPECULAR:
+            return 2;
+        case GL_EMISSION:
+            return 3;
+    }
+    return -1;
+}
+
+int RenderState::getLightIndex(GLenum name)
+{
+    switch (name)
+    {
+        case GL_AMBIENT:
+            return 0;
+        case GL_DIFFUSE:
+            return 1;
+        case GL_SPECULAR:
+            return 2;
+    }
+    return -1;
+}
@@ -0,0 +1,83 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#define GLFW_INCLUDE_GLEXT
+
+#include <GLFW/glfw3.h>
+#include <cstdint>
+
+/**
+ * Shadow copy of the OpenGL state that meshes change most often: texture
+ * bindings, material, blend function and lights. Calls that would set the
+ * value that is already current are dropped.
+ *
+ * All changes of this state have to go through this class, otherwise the
+ * shadow copy is out of date. Call invalidate() after code that bypasses it.
+ * Light positions are always issued, because OpenGL transforms them with the
+ * modelview matrix current at the time of the call.
+ */
+class RenderState
+{
+  public:
+    struct Statistics
+    {
+        uint32_t issued;
+        uint32_t skipped;
+    };
+
+    static void setActiveTexture(GLenum unit);
+    static void bindTexture(GLuint texture);
+    static void setMaterial(GLenum name, const float *value);
+    static void setShininess(float shininess);
+    static void setBlendFunc(GLenum source, GLenum destination);
+    static void setLightEnabled(GLenum light, bool enabled);
+    static void setLight(GLenum light, GLenum name, const float *value);
+    static void invalidate();
+    static void resetStatistics();
+    static const Statistics &getStatistics();
+
+  private:
+    static constexpr int maxTextureUnits = 8;
+    static constexpr int maxLights = 8;
+    static constexpr GLenum unknown = 0xFFFFFFFF;
+
+    struct CachedColor
+    {
+        float value[4];
+        bool valid;
+    };
+
+    static bool change(CachedColor &cached, const float *value);
+    static int getMaterialIndex(GLenum name);
+    static int getLightIndex(GLenum name);
+
+    static inline GLenum activeTexture = unknown;
+    static inline GLuint textures[maxTextureUnits] = {};
+    static inline bool texturesValid[maxTextureUnits] = {};
+    static inline CachedColor material[4] = {};
+    static inline float shininess = 0.0f;
+    static inline bool shininessValid = false;
+    static inline GLenum blendSource = unknown;
+    static inline GLenum blendDestination = unknown;
+    static inline int8_t lightsEnabled[maxLights] = {-1, -1, -1, -1, -1, -1, -1, -1};
+    static inline CachedColor lights[maxLights][3] = {};
+    static inline Statistics statistics = {};
+};
@@ -21,9 +21,20 @@
 
 #include "scene.h"
 
+#include "renderstate.h"
+#include "trace.h"
+
 #include <GLFW/glfw3.h>
 
-Scene::Scene()
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+/**
+ * @param name Shown in the profiler, has to stay valid for the lifetime of the program.
+ */
+Scene::Scene(const char *name)
+    : name(name)
 {
 }
 
@@ -31,38 +42,180 @@ Scene::~Scene()
 {
 }
 
-void Scene::addMesh(const std::shared_ptr<Mesh> &mesh)
+/**
+ * Adds a transform without geometry, e.g. to group nodes that move together.
+ *
+ * @param transform The local transform of the node.
+ * @param parent The node this one is attached to, or noParent for the root.
+ * @return The id of the new node, which stays valid when more nodes are added.
+ */
+Scene::NodeId Scene::addNode(const std::shared_ptr<Transform> &transform, NodeId parent)
 {
-    meshes.push_back(mesh);
+    return insertNode(transform, nullptr, parent);
 }
 
-void Scene::render(const Camera &camera) const
+/**
+ * Adds a mesh that is rendered with the world matrix of its node.
+ */
+Scene::NodeId Scene::addMesh(const std::shared_ptr<Mesh> &mesh, NodeId parent)
+{
+    return insertNode(mesh, mesh.get(), parent);
+}
+
+Scene::NodeId Scene::insertNode(const std::shared_ptr<Transform> &transform, Mesh *mesh, NodeId parent)
 {
-    if (fixedPosition)
+    uint32_t position = static_cast<uint32_t>(nodes.size());
+    uint32_t parentIndex = noParent;
+    if (parent != noParent)
     {
-        camera.loadFixedViewMatrix();
+        if (parent >= nodeIndices.size()) throw std::out_of_range("Unknown parent node");
+        parentIndex = nodeIndices[parent];
+        position = parentIndex + nodes[parentIndex].subtreeSize;
+
+        for (uint32_t ancestor = parentIndex; ancestor != noParent; ancestor = nodes[ancestor].parent)
+        {
+            nodes[ancestor].subtreeSize++;
+        }
     }
-    else
+
+    // Everything behind the insertion point moves up by one
+    for (uint32_t i = position; i < nodes.size(); i++)
     {
-        camera.loadViewMatrix();
+        nodeIndices[nodes[i].id]++;
+        if (nodes[i].parent != noParent && nodes[i].parent >= position) nodes[i].parent++;
     }
 
-    glEnable(GL_LIGHT1);
-    glLightfv(GL_LIGHT1, GL_POSITION, lightPosition);
-    glLightfv(GL_LIGHT1, GL_AMBIENT, lightAmbient);
-    glLightfv(GL_LIGHT1, GL_DIFFUSE, lightDiffuse);
-    glLightfv(GL_LIGHT1, GL_SPECULAR, lightSpecular);
+    NodeId id = static_cast<NodeId>(nodeIndices.size());
+    nodes.insert(nodes.begin() + position, Node{transform, mesh, id, parentIndex, 1, true, Matrix4f::scale(1), Vector4f(0, 0, 0, 0)});
+    nodeIndices.push_back(position);
+    return id;
+}
 
-    for (const std::shared_ptr<Mesh> &mesh : meshes)
+/**
+ * Recomputes the world matrices of all nodes whose local transform or one of
+ * whose ancestors changed since the last update.
+ */
+void Scene::update()
+{
+    for (Node &node : nodes)
     {
-        mesh->render();
+        bool localChanged = node.transform->updateLocalMatrix();
+        bool parentChanged = node.parent != noParent && nodes[node.parent].changed;
+        node.changed = localChanged || parentChanged;
+
+        if (node.changed)
+        {
+            const Matrix4f &localMatrix = node.transform->getLocalMatrix();
+            node.worldMatrix = node.parent != noParent ? nodes[node.parent].worldMatrix * localMatrix : localMatrix;
+            statistics.computed++;
+
+            if (node.mesh)
+            {
+                const Bounds &bounds = node.mesh->getBounds();
+                const Matrix4f &m = node.worldMatrix;
+                Vector4f center = m * Vector4f(bounds.center, 1.0f);
+                float scaleX = m.m11 * m.m11 + m.m12 * m.m12 + m.m13 * m.m13;
+                float scaleY = m.m21 * m.m21 + m.m22 * m.m22 + m.m23 * m.m23;
+                float scaleZ = m.m31 * m.m31 + m.m32 * m.m32 + m.m33 * m.m33;
+                float scale = std::sqrt(std::max(scaleX, std::max(scaleY, scaleZ)));
+                node.boundingSphere = Vector4f(center.xyz(), bounds.radius * scale);
+            }
+        }
+        else
+        {
+            statistics.reused++;
+        }
     }
+}
 
-    glDisable(GL_LIGHT1);
+/**
+ * Draws this scene on its own, see submit().
+ */
+void Scene::render(const Camera &camera) const
+{
+    TRACE_ZONE("Scene::render");
+    queue.clear();
+    submit(queue, camera);
+    queue.execute();
+}
 
-    if (depthIsolation)
+/**
+ * Adds the visible meshes of this scene to the queue, in a layer of their
+ * own that loads the view matrix and the light of the scene and clears the
+ * depth buffer afterwards if depth isolation is enabled. The camera and the
+ * scene have to stay unchanged until the queue has been executed.
+ */
+void Scene::submit(RenderQueue &queue, const Camera &camera) const
+{
+    TRACE_ZONE("Scene::submit");
+    uint32_t layer = queue.addLayer(name, [this, &camera]()
     {
-        glClear(GL_DEPTH_BUFFER_BIT);
+        if (fixedPosition)
+        {
+            camera.loadFixedViewMatrix();
+        }
+        else
+        {
+            camera.loadViewMatrix();
+        }
+
+        RenderState::setLightEnabled(GL_LIGHT1, true);
+        RenderState::setLight(GL_LIGHT1, GL_POSITION, lightPosition);
+        RenderState::setLight(GL_LIGHT1, GL_AMBIENT, lightAmbient);
+        RenderState::setLight(GL_LIGHT1, GL_DIFFUSE, lightDiffuse);
+        RenderState::setLight(GL_LIGHT1, GL_SPECULAR, lightSpecular);
+    },
+    [this]()
+    {
+        RenderState::setLightEnabled(GL_LIGHT1, false);
+
+        if (depthIsolation)
+        {
+            glClear(GL_DEPTH_BUFFER_BIT);
+        }
+    });
+
+    // Gather the spheres of all meshes and test them against the frustum at once
+    cullNodes.clear();
+    for (uint32_t i = 0; i < nodes.size(); i++)
+    {
+        if (nodes[i].mesh) cullNodes.push_back(i);
+    }
+    size_t count = cullNodes.size();
+    cullSpheres.resize(count * 4);
+    cullVisible.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        const Vector4f &sphere = nodes[cullNodes[i]].boundingSphere;
+        cullSpheres[i] = sphere.x;
+        cullSpheres[count + i] = sphere.y;
+        cullSpheres[2 * count + i] = sphere.z;
+        cullSpheres[3 * count + i] = sphere.w;
+    }
+    Frustum frustum = camera.getFrustum(fixedPosition);
+    const float *spheres = cullSpheres.data();
+    Math::testSpheres(frustum.planes, 6, spheres, spheres + count, spheres + 2 * count, spheres + 3 * count, cullVisible.data(), count);
+
+    Vector3f eye = camera.getPosition(fixedPosition).as<float>();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!cullVisible[i])
+        {
+            statistics.culled++;
+            continue;
+        }
+        const Node &node = nodes[cullNodes[i]];
+        node.mesh->selectDetail(camera, fixedPosition, node.worldMatrix);
+
+        // Distance to the nearest point of the bounding sphere
+        const Vector4f &sphere = node.boundingSphere;
+        float dx = sphere.x - eye.x;
+        float dy = sphere.y - eye.y;
+        float dz = sphere.z - eye.z;
+        float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - sphere.w;
+
+        queue.submit(layer, *node.mesh, node.worldMatrix, distance);
+        statistics.drawn++;
     }
 }
 
@@ -94,4 +247,19 @@ void Scene::enableDepthIsolation()
 void Scene::enableFixedPosition()
 {
     fixedPosition = true;
-}
\ No newline at end of file
+}
+
+void Scene::resetStatistics()
+{
+    statistics = {};
+}
+
+/**
+ * Returns how many world matrices update() computed and how many it could
+ * keep, and how many meshes render() drew and culled since the last call to
+ * resetStatistics().
+ */
+const Scene::Statistics &Scene::getStatistics()
+{
+    return statistics;
+}
@@ -21,27 +21,86 @@
 
 #include "camera.h"
 #include "mesh.h"
+#include "renderqueue.h"
+#include "transform.h"
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
+/**
+ * A hierarchy of transforms, some of which are meshes.
+ *
+ * The nodes are kept in a flat array in depth-first order, so every parent
+ * comes before its children and update() computes all world matrices in a
+ * single linear pass. World matrices are only recomputed below nodes whose
+ * local transform changed.
+ *
+ * Each scene is one layer of a RenderQueue. Layers are drawn in the order
+ * the scenes were submitted, so a scene with depth isolation hides nothing
+ * of the scenes after it.
+ */
 class Scene
 {
   public:
-    Scene();
+    using NodeId = uint32_t;
+    static constexpr NodeId noParent = UINT32_MAX;
+
+    struct Statistics
+    {
+        uint32_t computed;
+        uint32_t reused;
+        uint32_t drawn;
+        uint32_t culled;
+    };
+
+    Scene(const char *name = "scene");
     ~Scene();
-    void addMesh(const std::shared_ptr<Mesh> &mesh);
+    NodeId addNode(const std::shared_ptr<Transform> &transform, NodeId parent = noParent);
+    NodeId addMesh(const std::shared_ptr<Mesh> &mesh, NodeId parent = noParent);
+    void update();
     void render(const Camera &camera) const;
+    void submit(RenderQueue &queue, const Camera &camera) const;
     void setLight(const Vector4 &position, const Color &diffuse, const Color &ambient, const Color &specular);
     void enableDepthIsolation();
     void enableFixedPosition();
 
+    static void resetStatistics();
+    static const Statistics &getStatistics();
+
   private:
-    std::vector<std::shared_ptr<Mesh>> meshes;
+    struct Node
+    {
+        std::shared_ptr<Transform> transform;
+        Mesh *mesh;
+        NodeId id;
+        uint32_t parent;
+        uint32_t subtreeSize;
+        bool changed;
+        Matrix4f worldMatrix;
+        Vector4f boundingSphere;
+    };
+
+    NodeId insertNode(const std::shared_ptr<Transform> &transform, Mesh *mesh, NodeId parent);
+
+    const char *name;
+    std::vector<Node> nodes;
+    std::vector<uint32_t> nodeIndices;
+
+    // Bounding spheres of the meshes gathered for the batched frustum test
+    mutable std::vector<uint32_t> cullNodes;
+    mutable std::vector<float> cullSpheres;
+    mutable std::vector<uint8_t> cullVisible;
+
+    // Used by render() when the scene is drawn on its own
+    mutable RenderQueue queue;
+
     float lightPosition[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-    float lightAmbient[3] = {0.0f, 0.0f, 0.0f};
-    float lightDiffuse[3] = {0.0f, 0.0f, 0.0f};
-    float lightSpecular[3] = {0.0f, 0.0f, 0.0f};
+    float lightAmbient[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    float lightDiffuse[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    float lightSpecular[4] = {0.0f, 0.0f, 0.0f, 1.0f};
     bool depthIsolation = false;
     bool fixedPosition = false;
+
+    static inline Statistics statistics = {};
 };
\ No newline at end of file
@@ -0,0 +1,108 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "shader.h"
+
+#include <stdexcept>
+#include <vector>
+
+static GLuint compile(GLenum type, const std::string &source)
+{
+    GLuint shader = GL::CreateShader(type);
+    const char *text = source.c_str();
+    GL::ShaderSource(shader, 1, &text, nullptr);
+    GL::CompileShader(shader);
+
+    GLint status = GL_FALSE;
+    GL::GetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        GLint length = 0;
+        GL::GetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+        std::vector<char> log(length + 1, '\0');
+        GL::GetShaderInfoLog(shader, length, nullptr, log.data());
+        GL::DeleteShader(shader);
+        throw std::runtime_error(std::string("Failed to compile shader: ") + log.data());
+    }
+    return shader;
+}
+
+Shader::Shader(const std::string &vertexSource, const std::string &fragmentSource)
+{
+    GLuint vertexShader = compile(GL_VERTEX_SHADER, vertexSource);
+    GLuint fragmentShader = 0;
+    try
+    {
+        fragmentShader = compile(GL_FRAGMENT_SHADER, fragmentSource);
+    }
+    catch (...)
+    {
+        GL::DeleteShader(vertexShader);
+        throw;
+    }
+
+    program = GL::CreateProgram();
+    GL::AttachShader(program, vertexShader);
+    GL::AttachShader(program, fragmentShader);
+    GL::LinkProgram(program);
+
+    // The program keeps the attached shaders alive as long as it needs them
+    GL::DeleteShader(vertexShader);
+    GL::DeleteShader(fragmentShader);
+
+    GLint status = GL_FALSE;
+    GL::GetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        GLint length = 0;
+        GL::GetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+        std::vector<char> log(length + 1, '\0');
+        GL::GetProgramInfoLog(program, length, nullptr, log.data());
+        GL::DeleteProgram(program);
+        throw std::runtime_error(std::string("Failed to link shader: ") + log.data());
+    }
+}
+
+Shader::~Shader()
+{
+    GL::DeleteProgram(program);
+}
+
+void Shader::use() const
+{
+    GL::UseProgram(program);
+}
+
+/**
+ * Switches back to the fixed-function pipeline.
+ */
+void Shader::useFixedFunction()
+{
+    GL::UseProgram(0);
+}
+
+GLint Shader::getAttribute(const char *name) const
+{
+    return GL::GetAttribLocation(program, name);
+}
+
+GLint Shader::getUniform(const char *name) const
+{
+    return GL::GetUniformLocation(program, name);
+}
@@ -0,0 +1,45 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "extensions.h"
+
+#include <string>
+
+/**
+ * A linked GLSL program made of a vertex and a fragment shader.
+ *
+ * Needs OpenGL 2.0, check GL::hasShaders() before creating one.
+ */
+class Shader
+{
+  public:
+    Shader(const std::string &vertexSource, const std::string &fragmentSource);
+    Shader(const Shader &) = delete;
+    Shader &operator=(const Shader &) = delete;
+    ~Shader();
+    void use() const;
+    static void useFixedFunction();
+    GLint getAttribute(const char *name) const;
+    GLint getUniform(const char *name) const;
+
+  private:
+    GLuint program = 0;
+};
@@ -19,25 +19,204 @@
 
 #include "simulation.h"
 
+#include "trace.h"
+
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 
-Simulation::Simulation(const std::shared_ptr<Mesh> &earth, const std::shared_ptr<Mesh> &satellite)
+namespace
+{
+    // All satellites of the constellation share one orbit radius
+    const double constellationScale = 10.0 / 6370.0;
+    const double constellationOrbitRadius = 6920.0 / 6370.0;
+
+    /**
+     * Interpolates between two angles in radians along the shorter way, so
+     * angles that wrapped around between two steps do not spin back.
+     */
+    double interpolateAngle(double from, double to, double t)
+    {
+        return from + std::remainder(to - from, deg2rad(360.0)) * t;
+    }
+
+    Vector3 interpolateAngles(const Vector3 &from, const Vector3 &to, double t)
+    {
+        return Vector3(interpolateAngle(from.x, to.x, t), interpolateAngle(from.y, to.y, t), interpolateAngle(from.z, to.z, t));
+    }
+}
+
+Simulation::Simulation(const std::shared_ptr<Mesh> &earth, const std::shared_ptr<Transform> &satelliteOrbit, const std::shared_ptr<Mesh> &satellite,
+                       const std::shared_ptr<InstancedMesh> &constellation)
 {
     this->earth = earth;
+    this->satelliteOrbit = satelliteOrbit;
     this->satellite = satellite;
+    this->constellation = constellation;
+    this->constellationSize = constellation->getInstanceCount();
+
+    // The orbits never leave the shell around the earth, so the bounds do not follow every step
+    const Bounds &local = constellation->getGeometry()->getBounds();
+    Vector3f c = local.center;
+    double offset = std::sqrt(c.x * c.x + c.y * c.y + c.z * c.z);
+    float reach = static_cast<float>(constellationOrbitRadius + (offset + local.radius) * constellationScale);
+    constellation->setBounds({{0.0f, 0.0f, 0.0f}, reach});
+}
+
+Simulation::~Simulation()
+{
+    stop();
+}
+
+/**
+ * Starts stepping on a thread of its own. The constellation keeps the number
+ * of instances it had when the simulation was created.
+ *
+ * @param stepsPerSecond The fixed rate of the simulation, independent of the frame rate.
+ */
+void Simulation::start(double stepsPerSecond)
+{
+    stop();
+
+    stepLength = 1.0 / stepsPerSecond;
+    received = false;
+
+    // The first frame already finds a snapshot
+    step(now(), snapshots.back());
+    snapshots.publish();
+
+    running = true;
+    thread = std::thread(&Simulation::run, this, stepsPerSecond);
+}
+
+void Simulation::stop()
+{
+    running = false;
+    if (thread.joinable()) thread.join();
+}
+
+/**
+ * The body of the simulation thread. Steps are taken at fixed times, if the
+ * thread falls behind by more than a few steps it skips ahead instead of
+ * trying to catch up.
+ */
+void Simulation::run(double stepsPerSecond)
+{
+    TRACE_THREAD("simulation");
+    using Clock = std::chrono::steady_clock;
+    const auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / stepsPerSecond));
+    const int maxBehind = 4;
+
+    double time = now();
+    auto deadline = Clock::now();
+    while (running)
+    {
+        step(time, snapshots.back());
+        snapshots.publish();
+
+        time += stepLength;
+        deadline += interval;
+        auto current = Clock::now();
+        if (current - deadline > interval * maxBehind)
+        {
+            time = now();
+            deadline = current;
+        }
+        std::this_thread::sleep_until(deadline);
+    }
+}
+
+/**
+ * Moves the meshes to the state one step before the present, interpolated
+ * between the two latest snapshots. Does nothing until the simulation
+ * thread published its first step.
+ */
+void Simulation::apply()
+{
+    TRACE_ZONE("Simulation::apply");
+    // fetch() hands the front slot back to the writer, so it is swapped out first to keep it as the previous snapshot
+    std::swap(previous, snapshots.front());
+    if (snapshots.fetch())
+    {
+        if (!received) previous = snapshots.front();
+        received = true;
+    }
+    else
+    {
+        std::swap(previous, snapshots.front());
+    }
+    if (!received) return;
+
+    const Snapshot &current = snapshots.front();
+    double span = current.time - previous.time;
+    double t = span > 0.0 ? (now() - stepLength - previous.time) / span : 1.0;
+    applySnapshot(previous, current, std::clamp(t, 0.0, 1.0));
 }
 
-void Simulation::update()
+/**
+ * Steps once at the given time and applies the result right away, for
+ * callers that do not run the simulation thread and need reproducible
+ * results.
+ *
+ * @param time Seconds since the epoch.
+ */
+void Simulation::update(double time)
 {
-    auto time = std::chrono::system_clock::now();
-    auto timeSinceEpoch = time.time_since_epoch();
-    double secondsSinceEpoch = std::chrono::duration<double>(timeSinceEpoch).count();
+    TRACE_ZONE("Simulation::update");
+    Snapshot snapshot;
+    step(time, snapshot);
+    applySnapshot(snapshot, snapshot, 0.0);
+}
 
-    updateEarthRotation(secondsSinceEpoch);
-    updateSatellitePosition(secondsSinceEpoch);
+void Simulation::step(double time, Snapshot &snapshot) const
+{
+    TRACE_ZONE("Simulation::step");
+    snapshot.time = time;
+    updateEarthRotation(time, snapshot);
+    updateSatellitePosition(time, snapshot);
+    updateConstellation(time, snapshot);
 }
 
-void Simulation::updateEarthRotation(double time)
+void Simulation::applySnapshot(const Snapshot &from, const Snapshot &to, double t)
+{
+    const double scale = 25.0 / 6370.0;
+    const double orbitRadius = 6770.0 / 6370.0;
+
+    earth->setRotation(interpolateAngles(from.earthRotation, to.earthRotation, t));
+    Vector3 orbit = interpolateAngles(from.orbitRotation, to.orbitRotation, t);
+    satelliteOrbit->setRotation(orbit);
+
+    // The satellite tumbles relative to the stars, so it undoes the rotation it inherits from its orbit
+    Vector3 tumble = interpolateAngles(from.satelliteRotation, to.satelliteRotation, t);
+    Matrix4 orbitInverse = Matrix4::rotateZ(-orbit.z) * Matrix4::rotateY(-orbit.y) * Matrix4::rotateX(-orbit.x);
+    satellite->setScale(scale);
+    satellite->setPosition(Vector3(0, 0, orbitRadius));
+    satellite->setRotation(orbitInverse * Matrix4::rotateX(tumble.x) * Matrix4::rotateY(tumble.y) * Matrix4::rotateZ(tumble.z));
+
+    if (to.instances.size() != constellationSize || from.instances.size() != constellationSize) return;
+
+    // Orbits advance by a tiny angle per step, interpolating the matrices linearly keeps them orthonormal enough
+    std::span<Instance> instances = constellation->editInstances();
+    float s = static_cast<float>(t);
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        const float *a = from.instances[i].transform;
+        const float *b = to.instances[i].transform;
+        for (int j = 0; j < 12; j++) instances[i].transform[j] = a[j] + (b[j] - a[j]) * s;
+        std::copy(to.instances[i].emission, to.instances[i].emission + 4, instances[i].emission);
+    }
+}
+
+/**
+ * Seconds since the epoch, the time base of the simulation.
+ */
+double Simulation::now()
+{
+    auto timeSinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration<double>(timeSinceEpoch).count();
+}
+
+void Simulation::updateEarthRotation(double time, Snapshot &snapshot) const
 {
     double timeOfDay = std::fmod(time, 86400);
     double earthRotation = timeOfDay / 86400.0 * deg2rad(360);
@@ -46,27 +225,53 @@ void Simulation::updateEarthRotation(double time)
 
     double earthEcliptic = cos(timeOfYear / 31557600.0 * deg2rad(360)) * deg2rad(-23.4);
 
-    earth->setRotation(Vector3(earthEcliptic, earthRotation, 0));
+    snapshot.earthRotation = Vector3(earthEcliptic, earthRotation, 0);
 }
 
-void Simulation::updateSatellitePosition(double time)
+void Simulation::updateSatellitePosition(double time, Snapshot &snapshot) const
 {
-    double scale = 25.0 / 6370.0;
-
     double orbitTime = 5400.0;
     double orbitProgress = std::fmod(time, orbitTime);
 
-    double orbitRadius = 6770.0 / 6370.0;
-    Vector4 position = Vector4(0.0, 0.0, orbitRadius, 1.0);
-
-    Matrix4 orbit = Matrix4::rotateX(deg2rad(45)) * Matrix4::rotateY(orbitProgress / orbitTime * deg2rad(360.0));
-    position = orbit * position;
+    // The orbit node carries the satellite around, it only sits at the radius
+    snapshot.orbitRotation = Vector3(deg2rad(45), orbitProgress / orbitTime * deg2rad(360.0), 0);
 
     double tumbleTime = 60.0;
     double tumbleProgress = std::fmod(time, tumbleTime);
     double tumble = tumbleProgress / tumbleTime * deg2rad(360.0);
-    
-    satellite->setScale(scale);
-    satellite->setPosition(position.xyz());
-    satellite->setRotation(Vector3(tumble, tumble, tumble));
-}
\ No newline at end of file
+    snapshot.satelliteRotation = Vector3(tumble, tumble, tumble);
+}
+
+/**
+ * Spreads the satellites of the constellation evenly over inclined orbital
+ * planes, like the shells of the large communication constellations.
+ */
+void Simulation::updateConstellation(double time, Snapshot &snapshot) const
+{
+    const size_t count = constellationSize;
+    snapshot.instances.resize(count);
+    if (count == 0) return;
+
+    const size_t planes = 24;
+    const size_t perPlane = (count + planes - 1) / planes;
+    const double orbitTime = 5730.0;
+    const double inclination = deg2rad(53.0);
+    const Colorf emission = {0.25f, 0.25f, 0.3f, 1.0f};
+
+    double orbitProgress = std::fmod(time, orbitTime) / orbitTime;
+    Matrix4 placement = Matrix4::translate(0.0, 0.0, constellationOrbitRadius) * Matrix4::scale(constellationScale);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t plane = i % planes;
+        size_t slot = i / planes;
+        double ascendingNode = deg2rad(360.0) * plane / planes;
+        double phase = deg2rad(360.0) * (orbitProgress + (slot + 0.5 * (plane % 2)) / perPlane);
+
+        Matrix4 orbit = Matrix4::rotateY(ascendingNode) * Matrix4::rotateX(inclination) * Matrix4::rotateY(phase);
+        Matrix4f transform = (orbit * placement).as<float>();
+        Instance &instance = snapshot.instances[i];
+        std::copy(transform.data(), transform.data() + 12, instance.transform);
+        std::copy(&emission.r, &emission.r + 4, instance.emission);
+    }
+}
@@ -19,19 +19,64 @@
 
 #pragma once
 
+#include "instancedmesh.h"
 #include "mesh.h"
+#include "transform.h"
+#include "triplebuffer.h"
 
+#include <atomic>
 #include <memory>
+#include <thread>
+#include <vector>
 
+/**
+ * Moves the earth, the satellite and the constellation.
+ *
+ * With start(), the simulation steps at a fixed rate on a thread of its own
+ * and publishes a snapshot of every step. apply() is called by the render
+ * thread once per frame and interpolates between the two latest snapshots,
+ * one step behind the present, so motion stays smooth at any frame rate.
+ * The meshes are only ever touched by the render thread.
+ */
 class Simulation
 {
   public:
-    Simulation(const std::shared_ptr<Mesh> &earth, const std::shared_ptr<Mesh> &satellite);
-    void update();
+    Simulation(const std::shared_ptr<Mesh> &earth, const std::shared_ptr<Transform> &satelliteOrbit, const std::shared_ptr<Mesh> &satellite,
+               const std::shared_ptr<InstancedMesh> &constellation);
+    ~Simulation();
+    void start(double stepsPerSecond);
+    void stop();
+    void apply();
+    void update(double time);
+    static double now();
 
   private:
-    void updateEarthRotation(double time);
-    void updateSatellitePosition(double time);
+    struct Snapshot
+    {
+        double time;
+        Vector3 earthRotation;
+        Vector3 orbitRotation;
+        Vector3 satelliteRotation;
+        std::vector<Instance> instances;
+    };
+
+    void run(double stepsPerSecond);
+    void step(double time, Snapshot &snapshot) const;
+    void updateEarthRotation(double time, Snapshot &snapshot) const;
+    void updateSatellitePosition(double time, Snapshot &snapshot) const;
+    void updateConstellation(double time, Snapshot &snapshot) const;
+    void applySnapshot(const Snapshot &from, const Snapshot &to, double t);
+
     std::shared_ptr<Mesh> earth;
+    std::shared_ptr<Transform> satelliteOrbit;
     std::shared_ptr<Mesh> satellite;
-};
\ No newline at end of file
+    std::shared_ptr<InstancedMesh> constellation;
+    size_t constellationSize;
+
+    TripleBuffer<Snapshot> snapshots;
+    Snapshot previous = {};
+    bool received = false;
+    double stepLength = 0.0;
+    std::thread thread;
+    std::atomic<bool> running = false;
+};
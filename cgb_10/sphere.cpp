@@ -19,12 +19,272 @@
 
 #include "sphere.h"
 
-Sphere::Sphere(std::shared_ptr<Texture> &texture)
+#include "geometrycache.h"
+#include "vertexcache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <numbers>
+#include <thread>
+
+/**
+ * Creates a unit sphere with a chain of tessellation levels.
+ *
+ * Level 0 has maxSegments segments, every further level halves the count
+ * until minSegments is reached. The finest level is active until
+ * selectDetail() picks another one. The levels are shared with all other
+ * spheres through the GeometryCache.
+ */
+Sphere::Sphere(std::shared_ptr<Texture> &texture, int maxSegments, int minSegments, Winding winding)
     : Mesh(texture)
 {
-    const int segments = 64;
+    for (int segments = maxSegments; segments >= minSegments && levels.size() < maxLevels; segments /= 2)
+    {
+        auto levelGeometry = GeometryCache::get({Shape::Sphere, segments, winding}, [segments](Geometry &geometry)
+        {
+            geometry.primitive = GL_TRIANGLES;
+            generate(segments, vertexCacheSize, geometry.vertices, geometry.indices);
+        });
+        levels.push_back(levelGeometry);
+        levelSegments.push_back(segments);
+    }
+    geometry = levels.front();
+}
+
+void Sphere::upload(bool releaseVertices)
+{
+    for (const std::shared_ptr<Geometry> &levelGeometry : levels)
+    {
+        levelGeometry->upload(releaseVertices);
+    }
+}
+
+/**
+ * Selects the coarsest level whose segments stay below pixelsPerSegment on
+ * screen. Finer levels are taken immediately, coarser ones only after the
+ * required segment count has dropped clearly below them.
+ */
+void Sphere::selectDetail(const Camera &camera, bool fixedPosition, const Matrix4f &worldMatrix)
+{
+    Vector3 center = Vector3f(worldMatrix.m41, worldMatrix.m42, worldMatrix.m43).as<double>();
+    double radius = std::sqrt(worldMatrix.m11 * worldMatrix.m11 + worldMatrix.m12 * worldMatrix.m12 + worldMatrix.m13 * worldMatrix.m13);
+
+    double projectedRadius = camera.getProjectedRadius(center, radius, fixedPosition);
+    double requiredSegments = 2.0 * std::numbers::pi * projectedRadius / pixelsPerSegment;
+
+    int desired = 0;
+    while (desired + 1 < static_cast<int>(levels.size()) && levelSegments[desired + 1] >= requiredSegments)
+    {
+        desired++;
+    }
+
+    if (desired < level || requiredSegments * (1.0 + hysteresis) <= levelSegments[desired])
+    {
+        level = desired;
+    }
+
+    geometry = levels[level];
+    statistics[level]++;
+}
+
+int Sphere::getLevel() const
+{
+    return level;
+}
+
+int Sphere::getSegments() const
+{
+    return levelSegments[level];
+}
+
+void Sphere::resetStatistics()
+{
+    statistics.fill(0);
+}
+
+/**
+ * Returns how many spheres were drawn with each level since the last call to
+ * resetStatistics(). Index 0 is the finest level.
+ */
+const std::array<uint32_t, Sphere::maxLevels> &Sphere::getStatistics()
+{
+    return statistics;
+}
+
+/**
+ * Runs fn(begin, end) on consecutive chunks of [0, count), spread across the
+ * available hardware threads once the amount of work justifies starting them.
+ */
+template <typename Function>
+static void parallelFor(int count, size_t work, Function fn)
+{
+    const size_t minWorkPerThread = 1 << 16;
+
+    int threads = static_cast<int>(std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), work / minWorkPerThread));
+    threads = std::clamp(threads, 1, std::max(1, count));
+
+    if (threads == 1)
+    {
+        fn(0, count);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (int i = 1; i < threads; i++)
+    {
+        workers.emplace_back(fn, count * i / threads, count * (i + 1) / threads);
+    }
+    fn(0, count / threads);
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+/**
+ * Generates an indexed unit sphere.
+ *
+ * Every grid point is stored once, only the texture seam is duplicated. The
+ * poles are emitted as triangle fans with one apex per segment, so each apex
+ * can carry its own texture coordinate instead of producing degenerate quads.
+ *
+ * Positions are evaluated in closed form from sine/cosine tables of the
+ * longitudes and latitudes and written straight into the preallocated
+ * buffers. Vertex rows and index bands are independent of each other and are
+ * split across worker threads for large segment counts.
+ *
+ * @param segments Number of segments around the equator, the sphere has half as many rings.
+ * @param cacheSize Vertex cache size the triangle order is optimized for, 0 emits plain row order.
+ * @param vertices Receives the unique vertices.
+ * @param indices Receives the triangle list.
+ */
+void Sphere::generate(int segments, size_t cacheSize, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices)
+{
+    const int rings = segments / 2;
+
+    std::vector<double> sinLongitude(segments + 1);
+    std::vector<double> cosLongitude(segments + 1);
+    for (int x = 0; x < segments; x++)
+    {
+        double longitude = 2.0 * std::numbers::pi * x / segments;
+        sinLongitude[x] = std::sin(longitude);
+        cosLongitude[x] = std::cos(longitude);
+    }
+    sinLongitude[segments] = sinLongitude[0];
+    cosLongitude[segments] = cosLongitude[0];
+
+    std::vector<double> sinLatitude(rings + 1);
+    std::vector<double> cosLatitude(rings + 1);
+    for (int y = 0; y <= rings; y++)
+    {
+        double latitude = std::numbers::pi * (static_cast<double>(y) / rings - 0.5);
+        sinLatitude[y] = std::sin(latitude);
+        cosLatitude[y] = std::cos(latitude);
+    }
+
+    const float tw = 1.0f / segments;
+    const float th = 1.0f / rings;
+
+    const uint32_t rowBase = segments;
+    const uint32_t southBase = rowBase + (rings - 1) * (segments + 1);
+
+    auto setVertex = [&](Vertex &vertex, int x, int y, float s, float t)
+    {
+        float px = static_cast<float>(sinLongitude[x] * cosLatitude[y]);
+        float py = static_cast<float>(-sinLatitude[y]);
+        float pz = static_cast<float>(cosLongitude[x] * cosLatitude[y]);
+        vertex.position[0] = vertex.normal[0] = px;
+        vertex.position[1] = vertex.normal[1] = py;
+        vertex.position[2] = vertex.normal[2] = pz;
+        vertex.texcoord[0] = s;
+        vertex.texcoord[1] = t;
+    };
+
+    vertices.resize(southBase + segments);
+    Vertex *vertexData = vertices.data();
+
+    for (int x = 0; x < segments; x++)
+    {
+        setVertex(vertexData[x], x, 0, (x + 0.5f) * tw, 1.0f);
+        setVertex(vertexData[southBase + x], x, rings, (x + 0.5f) * tw, 0.0f);
+    }
+
+    parallelFor(rings - 1, vertices.size(), [&](int begin, int end)
+    {
+        for (int y = begin + 1; y < end + 1; y++)
+        {
+            Vertex *row = vertexData + rowBase + (y - 1) * (segments + 1);
+            for (int x = 0; x <= segments; x++)
+            {
+                setVertex(row[x], x, y, x * tw, (rings - y) * th);
+            }
+        }
+    });
+
+    auto index = [&](int x, int y) -> uint32_t
+    {
+        if (y == 0) return x;
+        if (y == rings) return southBase + x;
+        return rowBase + (y - 1) * (segments + 1) + x;
+    };
+
+    // Walking the grid in narrow column bands keeps the previous row of the
+    // band in the vertex cache, so almost every vertex is transformed once.
+    int band = cacheSize > 0 ? std::max<int>(1, static_cast<int>(cacheSize) / 2 - 2) : segments;
+    int bands = (segments + band - 1) / band;
+
+    // Every column contributes one triangle per pole row and two per inner row.
+    const size_t indicesPerColumn = 6 * static_cast<size_t>(rings - 1);
+
+    indices.resize(segments * indicesPerColumn);
+    uint32_t *indexData = indices.data();
+
+    parallelFor(bands, indices.size(), [&](int begin, int end)
+    {
+        for (int bandIndex = begin; bandIndex < end; bandIndex++)
+        {
+            int x0 = bandIndex * band;
+            int x1 = std::min(segments, x0 + band);
+            uint32_t *out = indexData + x0 * indicesPerColumn;
+
+            for (int y = 0; y < rings; y++)
+            {
+                for (int x = x0; x < x1; x++)
+                {
+                    uint32_t a = index(x, y + 1);
+                    uint32_t b = index(x + 1, y + 1);
+                    uint32_t c = index(x + 1, y);
+                    uint32_t d = index(x, y);
+
+                    if (y == 0)
+                    {
+                        *out++ = a; *out++ = b; *out++ = d;
+                    }
+                    else if (y == rings - 1)
+                    {
+                        *out++ = a; *out++ = c; *out++ = d;
+                    }
+                    else
+                    {
+                        *out++ = a; *out++ = b; *out++ = c;
+                        *out++ = a; *out++ = c; *out++ = d;
+                    }
+                }
+            }
+        }
+    });
+}
+
+/**
+ * The quad list construction used before the closed-form generator, kept as
+ * the baseline for printBenchmark().
+ */
+static std::vector<Vertex> generateWithMatrices(int segments)
+{
     const int rings = segments / 2;
-    const int vcount = segments * rings * 4;
 
     std::vector<std::vector<Vector3>> vectors(segments + 1, std::vector<Vector3>(rings + 1, Vector3(0.0, 0.0, 0.0)));
 
@@ -43,7 +303,8 @@ Sphere::Sphere(std::shared_ptr<Texture> &texture)
             vectors[x][y] = result.xyz();
         }
     }
-    int i = 0;
+
+    std::vector<Vertex> vertices;
     for (int y = 0; y < rings; y++)
     {
         for (int x = 0; x < segments; x++)
@@ -51,10 +312,78 @@ Sphere::Sphere(std::shared_ptr<Texture> &texture)
             double tw = 1.0 / segments;
             double th = 1.0 / rings;
             double ty = rings - y;
-            vertices.emplace_back(vectors[x][y + 1], vectors[x][y + 1], Vector2(x * tw, (ty - 1) * th));
-            vertices.emplace_back(vectors[x + 1][y + 1], vectors[x + 1][y + 1], Vector2((x + 1) * tw, (ty - 1) * th));
-            vertices.emplace_back(vectors[x + 1][y], vectors[x + 1][y], Vector2((x + 1) * tw, (ty)*th));
-            vertices.emplace_back(vectors[x][y], vectors[x][y], Vector2(x * tw, (ty)*th));
+            vertices.emplace_back(vectors[x][y + 1].as<float>(), vectors[x][y + 1].as<float>(), Vector2(x * tw, (ty - 1) * th).as<float>());
+            vertices.emplace_back(vectors[x + 1][y + 1].as<float>(), vectors[x + 1][y + 1].as<float>(), Vector2((x + 1) * tw, (ty - 1) * th).as<float>());
+            vertices.emplace_back(vectors[x + 1][y].as<float>(), vectors[x + 1][y].as<float>(), Vector2((x + 1) * tw, (ty)*th).as<float>());
+            vertices.emplace_back(vectors[x][y].as<float>(), vectors[x][y].as<float>(), Vector2(x * tw, (ty)*th).as<float>());
+        }
+    }
+    return vertices;
+}
+
+/**
+ * Measures sphere construction with rotation matrices against the closed-form
+ * generator at several segment counts.
+ */
+void Sphere::printBenchmark()
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::printf("%8s %14s %14s %10s (%u threads)\n", "segments", "matrices [ms]", "closed [ms]", "speedup",
+                std::max(1u, std::thread::hardware_concurrency()));
+
+    for (int segments : {64, 1024, 4096})
+    {
+        const int runs = segments <= 64 ? 100 : 1;
+
+        auto start = Clock::now();
+        for (int i = 0; i < runs; i++)
+        {
+            std::vector<Vertex> vertices = generateWithMatrices(segments);
         }
+        double matrixTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / runs;
+
+        start = Clock::now();
+        for (int i = 0; i < runs; i++)
+        {
+            std::vector<Vertex> vertices;
+            std::vector<uint32_t> indices;
+            generate(segments, vertexCacheSize, vertices, indices);
+        }
+        double closedTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / runs;
+
+        std::printf("%8d %14.3f %14.3f %9.1fx\n", segments, matrixTime, closedTime, matrixTime / closedTime);
+    }
+}
+
+/**
+ * Prints vertex memory and vertex cache efficiency of the indexed sphere
+ * compared to the former quad list at several tessellation levels.
+ */
+void Sphere::printReport()
+{
+    std::printf("%8s %10s %10s %10s %10s %8s %10s %10s %10s %10s\n",
+                "segments", "quad verts", "quad KiB", "idx verts", "indices", "idx size", "idx KiB", "saved",
+                "ACMR rows", "ACMR opt");
+
+    for (int segments : {16, 32, 64, 128, 256, 512})
+    {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> rowIndices;
+        std::vector<uint32_t> indices;
+        generate(segments, 0, vertices, rowIndices);
+        generate(segments, vertexCacheSize, vertices, indices);
+
+        size_t quadVertices = static_cast<size_t>(segments) * (segments / 2) * 4;
+        size_t quadBytes = quadVertices * sizeof(Vertex);
+        size_t indexSize = vertices.size() <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+        size_t indexedBytes = vertices.size() * sizeof(Vertex) + indices.size() * indexSize;
+
+        std::printf("%8d %10zu %10.1f %10zu %10zu %7zub %10.1f %9.1f%% %10.3f %10.3f\n",
+                    segments, quadVertices, quadBytes / 1024.0, vertices.size(), indices.size(), indexSize,
+                    indexedBytes / 1024.0, 100.0 * (1.0 - static_cast<double>(indexedBytes) / quadBytes),
+                    computeAcmr(rowIndices, vertexCacheSize), computeAcmr(indices, vertexCacheSize));
     }
-}
\ No newline at end of file
+
+    std::printf("ACMR simulated with a %zu entry FIFO cache, the quad list transforms 2.0 vertices per triangle.\n", vertexCacheSize);
+}
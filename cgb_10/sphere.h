@@ -19,10 +19,51 @@
 
 #pragma once
 
+#include "geometrycache.h"
 #include "mesh.h"
 
+#include <array>
+#include <cstdint>
+#include <vector>
+
 class Sphere : public Mesh
 {
   public:
-    Sphere(std::shared_ptr<Texture> &texture);
+    static constexpr int maxLevels = 8;
+
+    Sphere(std::shared_ptr<Texture> &texture, int maxSegments = 128, int minSegments = 8, Winding winding = Winding::CounterClockwise);
+    void upload(bool releaseVertices = false) override;
+    void selectDetail(const Camera &camera, bool fixedPosition, const Matrix4f &worldMatrix) override;
+    int getLevel() const;
+    int getSegments() const;
+    static void generate(int segments, size_t cacheSize, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+    static void printReport();
+    static void printBenchmark();
+    static void resetStatistics();
+    static const std::array<uint32_t, maxLevels> &getStatistics();
+
+    /**
+     * Size of the post-transform vertex cache the index order is optimized for.
+     * The triangles are emitted in column bands narrow enough that two rows of
+     * a band stay resident, which also works well for larger caches.
+     */
+    static constexpr size_t vertexCacheSize = 16;
+
+    /**
+     * Target length of a segment edge on screen. A level is only chosen if its
+     * segments are at most this many pixels long along the silhouette.
+     */
+    static constexpr double pixelsPerSegment = 8.0;
+
+    /**
+     * Fraction by which the required segment count has to drop below a coarser
+     * level before switching to it, so levels do not pop back and forth.
+     */
+    static constexpr double hysteresis = 0.25;
+
+  private:
+    std::vector<std::shared_ptr<Geometry>> levels;
+    std::vector<int> levelSegments;
+    int level = 0;
+    static inline std::array<uint32_t, maxLevels> statistics = {};
 };
\ No newline at end of file
@@ -21,34 +21,584 @@
 
 #include "texture.h"
 
+#include "extensions.h"
+#include "renderstate.h"
+#include "trace.h"
+
 #include <stb_image.h>
 
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <stdexcept>
 
-Texture::Texture(const std::string &filename)
-    : filename(filename)
+/**
+ * Format of tightly packed pixels with the given number of channels, gray
+ * images are read as luminance.
+ */
+GLenum Texture::getPixelFormat(int channels)
+{
+    switch (channels)
+    {
+        case 1:
+            return GL_LUMINANCE;
+        case 2:
+            return GL_LUMINANCE_ALPHA;
+        case 4:
+            return GL_RGBA;
+        default:
+            return GL_RGB;
+    }
+}
+
+/**
+ * Both compressed formats store 8 bytes per block of 4x4 pixels.
+ */
+static size_t getCompressedSize(int width, int height)
+{
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * 8;
+}
+
+/**
+ * Mirrors the rows of a BC1 or BC4 block vertically. Only the first rows
+ * are used if the level is less than four pixels high.
+ */
+static void flipBlock(unsigned char *block, GLenum format, int rows)
+{
+    if (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+    {
+        // A byte of 2 bit indices per row
+        std::reverse(block + 4, block + 4 + rows);
+        return;
+    }
+
+    // 12 bits of 3 bit indices per row, all rows in one little endian 48 bit number
+    uint64_t indices = 0, flipped = 0;
+    for (int i = 0; i < 6; i++) indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+    for (int row = 0; row < 4; row++)
+    {
+        int source = row < rows ? rows - 1 - row : row;
+        flipped |= (indices >> (12 * source) & 0xFFF) << (12 * row);
+    }
+    for (int i = 0; i < 6; i++) block[2 + i] = static_cast<unsigned char>(flipped >> (8 * i));
+}
+
+/**
+ * Blocks cannot be split, so a level can only be flipped exactly if its
+ * padding stays within its single row of blocks.
+ */
+static bool isFlippable(int height)
 {
+    return height <= 4 || height % 4 == 0;
+}
+
+/**
+ * DDS stores the top row first, so both the rows of blocks and the rows
+ * within each block are flipped. Only the last block row in the file can
+ * be partly padding, after the swap it is the first one. Its padding then
+ * ends up inside the image unless the level is at most four pixels high,
+ * see isFlippable().
+ */
+static void flipLevel(unsigned char *blocks, GLenum format, int width, int height)
+{
+    size_t rowSize = static_cast<size_t>((width + 3) / 4) * 8;
+    int blockRows = (height + 3) / 4;
+    for (int row = 0; row < blockRows / 2; row++)
+    {
+        std::swap_ranges(blocks + row * rowSize, blocks + (row + 1) * rowSize, blocks + (blockRows - 1 - row) * rowSize);
+    }
+    for (int row = 0; row < blockRows; row++)
+    {
+        int rows = row == 0 && height % 4 ? height % 4 : 4;
+        for (size_t offset = row * rowSize; offset < (row + 1) * rowSize; offset += 8)
+        {
+            flipBlock(blocks + offset, format, rows);
+        }
+    }
+}
+
+/**
+ * @param internalFormat Format on the GPU, for example GL_INTENSITY for a
+ *                       grayscale image that is also needed as alpha value.
+ */
+Texture::Texture(const std::string &filename, GLint internalFormat)
+    : filename(filename),
+      internalFormat(internalFormat)
+{
+    TRACE_ZONE("Texture::Texture");
+    queryCompressedFormats();
+    upload(decode(filename), std::chrono::steady_clock::time_point::max());
+}
+
+/**
+ * Shows a single texel of the placeholder color until upload() has finished.
+ */
+Texture::Texture(const std::string &filename, GLint internalFormat, const Color &placeholder)
+    : filename(filename),
+      internalFormat(internalFormat)
+{
+    queryCompressedFormats();
+    const Colorf color = placeholder.as<float>();
     glGenTextures(1, &id);
-    glBindTexture(GL_TEXTURE_2D, id);
+    RenderState::bindTexture(id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, 1, 1, 0, GL_RGBA, GL_FLOAT, &color);
+}
+
+Texture::~Texture()
+{
+}
+
+void Texture::ImageDeleter::operator()(unsigned char *pixels) const
+{
+    stbi_image_free(pixels);
+}
+
+const unsigned char *Texture::Image::getData() const
+{
+    if (compressedFormat) return blocks.data();
+    return mapped ? mapped : pixels.get();
+}
+
+/**
+ * Size of the pixels or blocks of a mipmap level in bytes, also after release().
+ */
+size_t Texture::Image::getLevelSize(int level) const
+{
+    int levelWidth = std::max(1, width >> level);
+    int levelHeight = std::max(1, height >> level);
+    if (compressedFormat)
+    {
+        return getCompressedSize(levelWidth, levelHeight);
+    }
+    return static_cast<size_t>(levelWidth) * levelHeight * channels;
+}
+
+/**
+ * Position of a mipmap level in the data, the levels follow each other without gaps.
+ */
+size_t Texture::Image::getLevelOffset(int level) const
+{
+    size_t offset = 0;
+    for (int i = 0; i < level; i++)
+    {
+        offset += getLevelSize(i);
+    }
+    return offset;
+}
+
+size_t Texture::Image::getSize() const
+{
+    return getLevelOffset(levels);
+}
+
+/**
+ * Frees the pixels or blocks once they have been copied elsewhere.
+ */
+void Texture::Image::release()
+{
+    pixels.reset();
+    blocks = {};
+    file.reset();
+    mapped = nullptr;
+}
+
+void Texture::queryCompressedFormats()
+{
+    if (compressedFormatsQueried) return;
+    bc1Supported = GL::hasCompressedFormat(GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+    bc4Supported = GL::hasCompressedFormat(GL_COMPRESSED_RED_RGTC1);
+    compressedFormatsQueried = true;
+}
+
+/**
+ * Loads an image file into memory, or the DDS or .mips file next to it if
+ * there is one in a supported format. Safe to call from any thread.
+ */
+Texture::Image Texture::decode(const std::string &filename)
+{
+    TRACE_ZONE("Texture::decode");
+    std::filesystem::path compressedFilename = std::filesystem::path(filename).replace_extension(".dds");
+    if (compressedFilename != filename && std::filesystem::exists(compressedFilename))
+    {
+        Image image = decodeCompressed(compressedFilename.string());
+        if (image.compressedFormat) return image;
+    }
+    std::filesystem::path mipmapsFilename = std::filesystem::path(filename).replace_extension(".mips");
+    if (mipmapsFilename != filename && std::filesystem::exists(mipmapsFilename))
+    {
+        return decodeMipmaps(mipmapsFilename.string());
+    }
+
+    Image image;
+    stbi_set_flip_vertically_on_load_thread(1);
+    image.pixels.reset(stbi_load(filename.c_str(), &image.width, &image.height, &image.channels, 0));
+    if (!image.pixels)
+    {
+        throw std::runtime_error("Failed to load texture " + filename);
+    }
+    return image;
+}
+
+/**
+ * Reads a DDS file with BC1 or BC4 blocks.
+ *
+ * @return An image without compressed format if the driver does not support the one of the file
+ *         or its first level cannot be flipped.
+ */
+Texture::Image Texture::decodeCompressed(const std::string &filename)
+{
+    struct Header
+    {
+        char magic[4];
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t linearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        uint32_t pixelFormatSize;
+        uint32_t pixelFormatFlags;
+        char fourCC[4];
+        uint32_t pixelFormatUnused[5];
+        uint32_t caps[4];
+        uint32_t reserved2;
+    };
+    static_assert(sizeof(Header) == 128, "Header must match the DDS file layout");
+
+    std::ifstream file(filename, std::ios::binary);
+    Header header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || std::memcmp(header.magic, "DDS ", 4) != 0 || header.size != 124)
+    {
+        throw std::runtime_error("Invalid DDS file " + filename);
+    }
+
+    Image image;
+    if (std::memcmp(header.fourCC, "DXT1", 4) == 0 && bc1Supported)
+    {
+        image.compressedFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        image.channels = 3;
+    }
+    else if ((std::memcmp(header.fourCC, "ATI1", 4) == 0 || std::memcmp(header.fourCC, "BC4U", 4) == 0) && bc4Supported)
+    {
+        image.compressedFormat = GL_COMPRESSED_RED_RGTC1;
+        image.channels = 1;
+    }
+    else
+    {
+        return {};
+    }
+    image.width = static_cast<int>(header.width);
+    image.height = static_cast<int>(header.height);
+    image.levels = static_cast<int>(std::max(1u, header.mipMapCount));
+    if (image.width <= 0 || image.height <= 0 || image.levels > 32)
+    {
+        throw std::runtime_error("Invalid DDS file " + filename);
+    }
+
+    image.blocks.resize(image.getSize());
+    if (!file.read(reinterpret_cast<char *>(image.blocks.data()), static_cast<std::streamsize>(image.blocks.size())))
+    {
+        throw std::runtime_error("Truncated DDS file " + filename);
+    }
+
+    // The mipmap chain ends before the first level that cannot be flipped, without the first level the image file is used
+    unsigned char *level = image.blocks.data();
+    for (int i = 0; i < image.levels; i++)
+    {
+        int width = std::max(1, image.width >> i), height = std::max(1, image.height >> i);
+        if (!isFlippable(height))
+        {
+            if (i == 0) return {};
+            image.levels = i;
+            image.blocks.resize(image.getSize());
+            break;
+        }
+        flipLevel(level, image.compressedFormat, width, height);
+        level += getCompressedSize(width, height);
+    }
+    return image;
+}
+
+/**
+ * Maps a .mips file. Only the header is read here, the pixels are read by
+ * the driver during the upload.
+ */
+Texture::Image Texture::decodeMipmaps(const std::string &filename)
+{
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t channels;
+        uint32_t levels;
+        uint32_t dataOffset;
+    };
 
+    auto file = std::make_shared<const MappedFile>(filename);
+    Header header;
+    if (file->size() < sizeof(header))
+    {
+        throw std::runtime_error("Invalid mipmap file " + filename);
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, "CGBMIPS", 8) != 0 || header.version != 1)
+    {
+        throw std::runtime_error("Invalid mipmap file " + filename);
+    }
+
+    Image image;
+    image.width = static_cast<int>(header.width);
+    image.height = static_cast<int>(header.height);
+    image.channels = static_cast<int>(header.channels);
+    image.levels = static_cast<int>(header.levels);
+    if (image.width <= 0 || image.height <= 0 || image.channels < 1 || image.channels > 4 || image.levels < 1 || image.levels > 32 ||
+        (std::max(image.width, image.height) >> (image.levels - 1)) != 1 || header.dataOffset + image.getSize() > file->size())
+    {
+        throw std::runtime_error("Invalid mipmap file " + filename);
+    }
+    image.mapped = file->data() + header.dataOffset;
+    image.file = std::move(file);
+    return image;
+}
+
+/**
+ * Creates a pixel buffer object for the image and maps it, so the pixels
+ * can be copied into memory the driver can transfer from without another
+ * copy. Any thread may write to the returned memory, but only until the
+ * next call of upload().
+ *
+ * @return Nullptr if the buffer could not be mapped, then upload() reads the pixels of the image.
+ */
+unsigned char *Texture::mapPixelBuffer(const Image &image)
+{
+    GL::GenBuffers(1, &pixelBuffer);
+    GL::BindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+    GL::BufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<ptrdiff_t>(image.getSize()), nullptr, GL_STREAM_DRAW);
+    void *memory = GL::MapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    GL::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!memory)
+    {
+        GL::DeleteBuffers(1, &pixelBuffer);
+        pixelBuffer = 0;
+        return nullptr;
+    }
+    pixelBufferMapped = true;
+    return static_cast<unsigned char *>(memory);
+}
+
+/**
+ * Copies the image into a new texture until the deadline has passed, from
+ * the pixel buffer if one was mapped. Pixels are copied in bands of rows
+ * and the mipmaps are generated after the last band, compressed images are
+ * copied one mipmap level at a time. Once a fence says the transfer is
+ * done, the new texture replaces the placeholder.
+ *
+ * @return True once the whole image has been uploaded.
+ */
+bool Texture::upload(const Image &image, std::chrono::steady_clock::time_point deadline)
+{
+    TRACE_ZONE("Texture::upload");
+    if (fence)
+    {
+        return finishUpload(deadline);
+    }
+    if (uploadId && uploadedLevels == image.levels)
+    {
+        return generateMipmaps(deadline);
+    }
+
+    if (!uploadId)
+    {
+        createUploadTexture(image);
+    }
+    RenderState::bindTexture(uploadId);
+
+    if (pixelBuffer)
+    {
+        GL::BindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+        if (pixelBufferMapped)
+        {
+            GL::UnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            pixelBufferMapped = false;
+        }
+    }
+    bool complete = image.compressedFormat ? uploadLevels(image, deadline) : uploadBands(image, deadline);
+    if (pixelBuffer)
+    {
+        GL::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    if (!complete)
+    {
+        return false;
+    }
+    if (image.levels > 1)
+    {
+        return placeFence(deadline);
+    }
+    // Generating the mipmaps of a large texture can take as long as all bands, so it waits for the next call if time is up
+    if (std::chrono::steady_clock::now() >= deadline)
+    {
+        return false;
+    }
+    return generateMipmaps(deadline);
+}
+
+/**
+ * BC4 only fills the red channel, swizzles spread it over the others like
+ * the luminance or intensity format that was asked for.
+ */
+void Texture::createUploadTexture(const Image &image)
+{
+    glGenTextures(1, &uploadId);
+    RenderState::bindTexture(uploadId);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+    uploadedRows = 0;
+    uploadedLevels = 0;
 
-    int width, height, channels;
-    stbi_set_flip_vertically_on_load(1);
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &channels, 0);
-    if (!data)
+    if (image.levels > 1)
     {
-        stbi_image_free(data);
-        throw std::runtime_error("Failed to load texture " + filename);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levels - 1);
+    }
+    if (!image.compressedFormat)
+    {
+        for (int level = 0; level < image.levels; level++)
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, internalFormat, std::max(1, image.width >> level), std::max(1, image.height >> level), 0,
+                         getPixelFormat(image.channels), GL_UNSIGNED_BYTE, nullptr);
+        }
+        return;
+    }
+
+    if (image.compressedFormat == GL_COMPRESSED_RED_RGTC1)
+    {
+        GLint alpha = internalFormat == GL_INTENSITY ? GL_RED : GL_ONE;
+        const GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, alpha};
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
     }
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    stbi_image_free(data);
 }
 
-Texture::~Texture()
+/**
+ * Copies one band of rows per step, level after level.
+ */
+bool Texture::uploadBands(const Image &image, std::chrono::steady_clock::time_point deadline)
+{
+    GLenum format = getPixelFormat(image.channels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    do
+    {
+        int width = std::max(1, image.width >> uploadedLevels), height = std::max(1, image.height >> uploadedLevels);
+        size_t rowSize = static_cast<size_t>(width) * image.channels;
+        int rows = std::min(static_cast<int>(std::max<size_t>(1, uploadBandSize / rowSize)), height - uploadedRows);
+        if (image.levels == 1 && uploadedRows + rows == height && !GL::hasGenerateMipmap())
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+        }
+
+        // With a pixel buffer bound, the pointer passed to glTexSubImage2D is an offset into it
+        size_t offset = image.getLevelOffset(uploadedLevels) + uploadedRows * rowSize;
+        const void *band = pixelBuffer ? reinterpret_cast<const void *>(offset) : image.getData() + offset;
+        glTexSubImage2D(GL_TEXTURE_2D, uploadedLevels, 0, uploadedRows, width, rows, format, GL_UNSIGNED_BYTE, band);
+        uploadedRows += rows;
+        if (uploadedRows == height)
+        {
+            uploadedRows = 0;
+            uploadedLevels++;
+        }
+    } while (uploadedLevels < image.levels && std::chrono::steady_clock::now() < deadline);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    return uploadedLevels == image.levels;
+}
+
+bool Texture::uploadLevels(const Image &image, std::chrono::steady_clock::time_point deadline)
+{
+    do
+    {
+        int width = std::max(1, image.width >> uploadedLevels), height = std::max(1, image.height >> uploadedLevels);
+        size_t offset = image.getLevelOffset(uploadedLevels);
+        const void *data = pixelBuffer ? reinterpret_cast<const void *>(offset) : image.getData() + offset;
+        GL::CompressedTexImage2D(GL_TEXTURE_2D, uploadedLevels, image.compressedFormat, width, height, 0, static_cast<GLsizei>(image.getLevelSize(uploadedLevels)), data);
+        uploadedLevels++;
+    } while (uploadedLevels < image.levels && std::chrono::steady_clock::now() < deadline);
+
+    return uploadedLevels == image.levels;
+}
+
+/**
+ * Generates the mipmaps once all bands have been uploaded, unless OpenGL
+ * already did so with the last band.
+ */
+bool Texture::generateMipmaps(std::chrono::steady_clock::time_point deadline)
+{
+    if (GL::hasGenerateMipmap())
+    {
+        RenderState::bindTexture(uploadId);
+        GL::GenerateMipmap(GL_TEXTURE_2D);
+    }
+    return placeFence(deadline);
+}
+
+/**
+ * Data in a pixel buffer may still be in transfer after the last upload call.
+ */
+bool Texture::placeFence(std::chrono::steady_clock::time_point deadline)
+{
+    if (pixelBuffer && GL::hasSync())
+    {
+        fence = GL::FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    return finishUpload(deadline);
+}
+
+/**
+ * Replaces the placeholder once the fence, if any, has been reached. Only
+ * waits for the fence if there is no deadline.
+ */
+bool Texture::finishUpload(std::chrono::steady_clock::time_point deadline)
 {
-}
\ No newline at end of file
+    if (fence)
+    {
+        uint64_t timeout = deadline == std::chrono::steady_clock::time_point::max() ? UINT64_MAX : 0;
+        GLenum status = GL::ClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+        GL::DeleteSync(fence);
+        fence = nullptr;
+    }
+    if (pixelBuffer)
+    {
+        GL::DeleteBuffers(1, &pixelBuffer);
+        pixelBuffer = 0;
+    }
+
+    // The placeholder may still be bound on another unit, the shadow copy would not notice its name being reused
+    if (id)
+    {
+        glDeleteTextures(1, &id);
+        RenderState::invalidate();
+    }
+    id = uploadId;
+    uploadId = 0;
+    loaded = true;
+    return true;
+}
+
+bool Texture::isLoaded() const
+{
+    return loaded;
+}
+
+const std::string &Texture::getFilename() const
+{
+    return filename;
+}
@@ -21,16 +21,98 @@
 
 #define GLFW_INCLUDE_GLEXT
 
+#include "cgmath.h"
+#include "mappedfile.h"
+
 #include <GLFW/glfw3.h>
+#include <chrono>
+#include <memory>
 #include <string>
+#include <vector>
 
+/**
+ * A 2D texture with mipmaps.
+ *
+ * If a DDS file with the same name exists and holds a block compressed
+ * format the driver supports, it is loaded instead of the image, together
+ * with the mipmaps stored in it. The texconv tool writes these files.
+ * Otherwise a .mips file from the texpack tool is used if there is one,
+ * which holds all mipmap levels uncompressed and is uploaded straight from
+ * a memory mapping.
+ *
+ * The first constructor loads the image right away. The second one only
+ * creates a single texel of the placeholder color, the image is decoded
+ * later with decode() and handed to upload(), usually by a TextureLoader,
+ * which may copy it into a pixel buffer from mapPixelBuffer() first.
+ * The id changes once the upload has finished.
+ */
 class Texture
 {
   public:
-    Texture(const std::string &filename);
+    struct ImageDeleter
+    {
+        void operator()(unsigned char *pixels) const;
+    };
+
+    /**
+     * Decoded pixels, mapped pixels or compressed blocks of all mipmap
+     * levels, largest first, each bottom row first as OpenGL expects them.
+     */
+    struct Image
+    {
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        int levels = 1;
+        GLenum compressedFormat = 0;
+        std::unique_ptr<unsigned char, ImageDeleter> pixels;
+        std::vector<unsigned char> blocks;
+        std::shared_ptr<const MappedFile> file;
+        const unsigned char *mapped = nullptr;
+
+        const unsigned char *getData() const;
+        size_t getLevelSize(int level) const;
+        size_t getLevelOffset(int level) const;
+        size_t getSize() const;
+        void release();
+    };
+
+    Texture(const std::string &filename, GLint internalFormat = GL_RGB);
+    Texture(const std::string &filename, GLint internalFormat, const Color &placeholder);
     ~Texture();
-    GLuint id;
+    unsigned char *mapPixelBuffer(const Image &image);
+    bool upload(const Image &image, std::chrono::steady_clock::time_point deadline);
+    bool isLoaded() const;
+    const std::string &getFilename() const;
+    static Image decode(const std::string &filename);
+    static GLenum getPixelFormat(int channels);
+    GLuint id = 0;
 
   private:
+    static constexpr size_t uploadBandSize = 4 << 20;
+
+    static Image decodeCompressed(const std::string &filename);
+    static Image decodeMipmaps(const std::string &filename);
+    static void queryCompressedFormats();
+    void createUploadTexture(const Image &image);
+    bool uploadBands(const Image &image, std::chrono::steady_clock::time_point deadline);
+    bool uploadLevels(const Image &image, std::chrono::steady_clock::time_point deadline);
+    bool generateMipmaps(std::chrono::steady_clock::time_point deadline);
+    bool placeFence(std::chrono::steady_clock::time_point deadline);
+    bool finishUpload(std::chrono::steady_clock::time_point deadline);
+
     std::string filename;
-};
\ No newline at end of file
+    GLint internalFormat;
+    GLuint uploadId = 0;
+    int uploadedRows = 0;
+    int uploadedLevels = 0;
+    GLuint pixelBuffer = 0;
+    bool pixelBufferMapped = false;
+    GLsync fence = nullptr;
+    bool loaded = false;
+
+    // Queried on the thread that owns the context, before any image is decoded
+    static inline bool compressedFormatsQueried = false;
+    static inline bool bc1Supported = false;
+    static inline bool bc4Supported = false;
+};
@@ -0,0 +1,191 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "textureloader.h"
+
+#include "extensions.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @param threadCount Number of worker threads, zero for one per core up to four.
+ */
+TextureLoader::TextureLoader(unsigned threadCount)
+    : pixelBuffers(GL::hasPixelBuffers())
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::clamp(std::thread::hardware_concurrency(), 1u, 4u);
+    }
+    for (unsigned i = 0; i < threadCount; i++)
+    {
+        workers.emplace_back(&TextureLoader::run, this);
+    }
+}
+
+TextureLoader::~TextureLoader()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    queuedChanged.notify_all();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+/**
+ * Queues an image file for decoding.
+ *
+ * @param internalFormat Format on the GPU, see Texture.
+ * @param placeholder Color of the texture until the image has been uploaded.
+ */
+std::shared_ptr<Texture> TextureLoader::load(const std::string &filename, GLint internalFormat, const Color &placeholder)
+{
+    auto job = std::make_unique<Job>();
+    job->texture = std::make_shared<Texture>(filename, internalFormat, placeholder);
+    auto texture = job->texture;
+    {
+        std::lock_guard lock(mutex);
+        queued.push_back(std::move(job));
+        pending++;
+    }
+    queuedChanged.notify_one();
+    return texture;
+}
+
+/**
+ * Uploads decoded images until the budget in seconds is used up. Images are
+ * uploaded in the order they finished decoding, one at a time.
+ */
+void TextureLoader::update(double budget)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(budget));
+    std::unique_lock lock(mutex);
+    while (!decoded.empty() && advance(lock, deadline) && std::chrono::steady_clock::now() < deadline)
+    {
+    }
+}
+
+/**
+ * Waits for all queued images and uploads them without a time limit.
+ */
+void TextureLoader::finish()
+{
+    TRACE_ZONE("TextureLoader::finish");
+    std::unique_lock lock(mutex);
+    while (pending > 0)
+    {
+        decodedChanged.wait(lock, [this] { return !decoded.empty(); });
+        advance(lock, std::chrono::steady_clock::time_point::max());
+    }
+}
+
+/**
+ * Number of images that are not uploaded completely yet.
+ */
+size_t TextureLoader::getPendingCount() const
+{
+    std::lock_guard lock(mutex);
+    return pending;
+}
+
+/**
+ * Takes the oldest decoded image one stage further. Errors of the worker
+ * threads are thrown here, on the thread that owns the OpenGL context.
+ *
+ * @return False if the upload was stopped by the deadline.
+ */
+bool TextureLoader::advance(std::unique_lock<std::mutex> &lock, std::chrono::steady_clock::time_point deadline)
+{
+    Job *job = decoded.front().get();
+    if (job->error)
+    {
+        std::exception_ptr error = job->error;
+        decoded.pop_front();
+        pending--;
+        std::rethrow_exception(error);
+    }
+
+    // Other jobs only ever get appended, the front one stays where it is while unlocked
+    lock.unlock();
+    if (job->stage == Stage::Map)
+    {
+        job->pixelBuffer = job->texture->mapPixelBuffer(job->image);
+        job->stage = job->pixelBuffer ? Stage::Copy : Stage::Upload;
+    }
+    bool finished = job->stage == Stage::Copy || job->texture->upload(job->image, deadline);
+    lock.lock();
+
+    if (!finished) return false;
+    if (job->stage == Stage::Copy)
+    {
+        queued.push_front(std::move(decoded.front()));
+        queuedChanged.notify_one();
+    }
+    else
+    {
+        pending--;
+    }
+    decoded.pop_front();
+    return true;
+}
+
+void TextureLoader::run()
+{
+    TRACE_THREAD("texture loader");
+    std::unique_lock lock(mutex);
+    while (true)
+    {
+        queuedChanged.wait(lock, [this] { return stopping || !queued.empty(); });
+        if (stopping) return;
+
+        std::unique_ptr<Job> job = std::move(queued.front());
+        queued.pop_front();
+        lock.unlock();
+        try
+        {
+            if (job->stage == Stage::Copy)
+            {
+                TRACE_ZONE("TextureLoader::copy");
+                std::memcpy(job->pixelBuffer, job->image.getData(), job->image.getSize());
+                job->image.release();
+                job->pixelBuffer = nullptr;
+                job->stage = Stage::Upload;
+            }
+            else
+            {
+                // Mapped files are read by the driver directly, a pixel buffer would only add a copy
+                job->image = Texture::decode(job->texture->getFilename());
+                job->stage = pixelBuffers && !job->image.mapped ? Stage::Map : Stage::Upload;
+            }
+        }
+        catch (...)
+        {
+            job->error = std::current_exception();
+        }
+        lock.lock();
+        decoded.push_back(std::move(job));
+        decodedChanged.notify_all();
+    }
+}
@@ -0,0 +1,85 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "texture.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Decodes image files on a pool of worker threads.
+ *
+ * load() returns a texture that shows a placeholder color right away. The
+ * decoded images are uploaded by update(), which has to be called on the
+ * thread that owns the OpenGL context and stops as soon as its time budget
+ * is used up, so a large image is spread over several frames.
+ *
+ * With pixel buffer objects, update() maps a buffer for each decoded image
+ * and a worker copies the pixels into it, so the render thread never
+ * touches them and the driver transfers them without a copy of its own.
+ * Images mapped from .mips files are uploaded from the mapping instead.
+ */
+class TextureLoader
+{
+  public:
+    TextureLoader(unsigned threadCount = 0);
+    ~TextureLoader();
+    std::shared_ptr<Texture> load(const std::string &filename, GLint internalFormat, const Color &placeholder);
+    void update(double budget);
+    void finish();
+    size_t getPendingCount() const;
+
+  private:
+    enum class Stage
+    {
+        Decode,
+        Map,
+        Copy,
+        Upload
+    };
+
+    struct Job
+    {
+        std::shared_ptr<Texture> texture;
+        Stage stage = Stage::Decode;
+        Texture::Image image;
+        unsigned char *pixelBuffer = nullptr;
+        std::exception_ptr error;
+    };
+
+    void run();
+    bool advance(std::unique_lock<std::mutex> &lock, std::chrono::steady_clock::time_point deadline);
+
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable queuedChanged;
+    std::condition_variable decodedChanged;
+    std::deque<std::unique_ptr<Job>> queued;
+    std::deque<std::unique_ptr<Job>> decoded;
+    size_t pending = 0;
+    bool pixelBuffers = false;
+    bool stopping = false;
+};
@@ -0,0 +1,164 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "trace.h"
+
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    const auto epoch = std::chrono::steady_clock::now();
+
+#if defined(CGB_TRACE)
+    void writeString(std::ostream &stream, const char *text)
+    {
+        stream << '"';
+        for (const char *c = text; *c; c++)
+        {
+            if (*c == '"' || *c == '\\') stream << '\\';
+            if (static_cast<unsigned char>(*c) >= 0x20) stream << *c;
+        }
+        stream << '"';
+    }
+#endif
+}
+
+Trace::Zone::Zone(const char *name)
+    : name(name), begin(now())
+{
+}
+
+Trace::Zone::~Zone()
+{
+    record(name, begin, now());
+}
+
+/**
+ * Names the calling thread in the trace, e.g. "render" or "simulation".
+ */
+void Trace::setThreadName(const char *name)
+{
+    getThreadBuffer().name.store(name, std::memory_order_release);
+}
+
+/**
+ * Writes all zones recorded so far. Threads may keep recording meanwhile,
+ * their newer zones are left out.
+ */
+void Trace::save(const std::string &filename)
+{
+#if defined(CGB_TRACE)
+    std::ofstream file(filename);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write trace: " + filename);
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for (const auto &entry : registry)
+    {
+        const ThreadBuffer &buffer = *entry;
+        if (const char *name = buffer.name.load(std::memory_order_acquire))
+        {
+            file << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer.id << ", \"args\": {\"name\": ";
+            writeString(file, name);
+            file << "}}";
+            first = false;
+        }
+
+        for (const Chunk *chunk = &buffer.first; chunk; chunk = chunk->next.load(std::memory_order_acquire))
+        {
+            size_t count = chunk->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; i++)
+            {
+                const Event &event = chunk->events[i];
+                file << (first ? "" : ",\n") << "{\"name\": ";
+                writeString(file, event.name);
+                file << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer.id << ", \"ts\": " << event.begin / 1000.0
+                     << ", \"dur\": " << (event.end - event.begin) / 1000.0 << "}";
+                first = false;
+            }
+        }
+    }
+    file << "\n]}\n";
+#else
+    throw std::runtime_error("Tracing is not compiled in, build with make TRACE=1 to write " + filename);
+#endif
+}
+
+/**
+ * Returns the buffer of the calling thread, registering it on first use.
+ */
+Trace::ThreadBuffer &Trace::getThreadBuffer()
+{
+    thread_local ThreadBuffer *buffer = nullptr;
+    if (!buffer)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(std::make_unique<ThreadBuffer>());
+        buffer = registry.back().get();
+        buffer->id = static_cast<uint32_t>(registry.size());
+    }
+    return *buffer;
+}
+
+/**
+ * Appends a zone to the buffer of the calling thread. Only the count is
+ * published atomically, the reader never looks past it.
+ */
+void Trace::record(const char *name, uint64_t begin, uint64_t end)
+{
+    ThreadBuffer &buffer = getThreadBuffer();
+    Chunk *chunk = buffer.last;
+    size_t count = chunk->count.load(std::memory_order_relaxed);
+    if (count == Chunk::capacity)
+    {
+        if (buffer.chunks == maxChunksPerThread) return;
+
+        Chunk *next = new Chunk();
+        chunk->next.store(next, std::memory_order_release);
+        buffer.last = chunk = next;
+        buffer.chunks++;
+        count = 0;
+    }
+    chunk->events[count] = {name, begin, end};
+    chunk->count.store(count + 1, std::memory_order_release);
+}
+
+Trace::ThreadBuffer::~ThreadBuffer()
+{
+    Chunk *chunk = first.next.load();
+    while (chunk)
+    {
+        Chunk *next = chunk->next.load();
+        delete chunk;
+        chunk = next;
+    }
+}
+
+/**
+ * Nanoseconds since the start of the program.
+ */
+uint64_t Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
@@ -0,0 +1,112 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Records zones of time per thread and writes them in the Chrome trace
+ * event format, which Perfetto and chrome://tracing display as timelines.
+ *
+ * Zones are only recorded in builds with CGB_TRACE defined (make TRACE=1),
+ * otherwise TRACE_ZONE and TRACE_THREAD expand to nothing. Every thread
+ * appends to a buffer of its own, so recording takes no locks; only the
+ * first zone of a thread registers its buffer.
+ */
+class Trace
+{
+  public:
+#if defined(CGB_TRACE)
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    /**
+     * Records the time from its construction to its destruction. The name
+     * has to stay valid until save() is called.
+     */
+    class Zone
+    {
+      public:
+        Zone(const char *name);
+        ~Zone();
+        Zone(const Zone &) = delete;
+        Zone &operator=(const Zone &) = delete;
+
+      private:
+        const char *name;
+        uint64_t begin;
+    };
+
+    static void setThreadName(const char *name);
+    static void save(const std::string &filename);
+
+  private:
+    struct Event
+    {
+        const char *name;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    struct Chunk
+    {
+        static constexpr size_t capacity = 4096;
+        Event events[capacity];
+        std::atomic<size_t> count = 0;
+        std::atomic<Chunk *> next = nullptr;
+    };
+
+    struct ThreadBuffer
+    {
+        ~ThreadBuffer();
+        uint32_t id;
+        std::atomic<const char *> name = nullptr;
+        Chunk first;
+        Chunk *last = &first;
+        size_t chunks = 1;
+    };
+
+    // Stops recording on a thread instead of growing without bounds
+    static constexpr size_t maxChunksPerThread = 1024;
+
+    static ThreadBuffer &getThreadBuffer();
+    static void record(const char *name, uint64_t begin, uint64_t end);
+    static uint64_t now();
+
+    // Buffers outlive their threads, so zones of finished threads are still saved
+    static inline std::mutex registryMutex;
+    static inline std::vector<std::unique_ptr<ThreadBuffer>> registry;
+};
+
+#if defined(CGB_TRACE)
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_ZONE(name) Trace::Zone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_THREAD(name) Trace::setThreadName(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_THREAD(name) ((void)0)
+#endif
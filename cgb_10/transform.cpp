@@ -0,0 +1,91 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "transform.h"
+
+#include <cmath>
+
+/**
+ * Setting the current value again leaves the cached local matrix valid.
+ */
+void Transform::setPosition(const Vector3 &position)
+{
+    Matrix4f translation = Matrix4::translate(position.x, position.y, position.z).as<float>();
+    if (translation.m41 == this->position.m41 && translation.m42 == this->position.m42 && translation.m43 == this->position.m43) return;
+
+    this->position = translation;
+    localMatrixDirty = true;
+}
+
+void Transform::setRotation(const Vector3 &rotation)
+{
+    if (rotation.x == rotationAngles.x && rotation.y == rotationAngles.y && rotation.z == rotationAngles.z) return;
+
+    rotationAngles = rotation;
+    this->rotation = (Matrix4::rotateX(rotation.x) * Matrix4::rotateY(rotation.y) * Matrix4::rotateZ(rotation.z)).as<float>();
+    localMatrixDirty = true;
+}
+
+/**
+ * Sets a rotation that is not made of angles around X, Y and Z in that order,
+ * e.g. one that cancels the rotation of a parent node.
+ */
+void Transform::setRotation(const Matrix4 &rotation)
+{
+    rotationAngles = {NAN, NAN, NAN};
+    this->rotation = rotation.as<float>();
+    localMatrixDirty = true;
+}
+
+void Transform::setScale(const double scale)
+{
+    Matrix4f scaling = Matrix4::scale(scale).as<float>();
+    if (scaling.m11 == this->scale.m11) return;
+
+    this->scale = scaling;
+    localMatrixDirty = true;
+}
+
+/**
+ * Recomputes position * rotation * scale if a setter changed it.
+ *
+ * @return True if the local matrix changed since the last call.
+ */
+bool Transform::updateLocalMatrix()
+{
+    if (!localMatrixDirty) return false;
+
+    localMatrix = position * rotation * scale;
+    localMatrixDirty = false;
+    return true;
+}
+
+/**
+ * Makes the next updateLocalMatrix() report a change, e.g. because something
+ * that depends on the node changed without touching the transform itself.
+ */
+void Transform::invalidate()
+{
+    localMatrixDirty = true;
+}
+
+const Matrix4f &Transform::getLocalMatrix() const
+{
+    return localMatrix;
+}
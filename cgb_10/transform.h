@@ -0,0 +1,53 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "cgmath.h"
+
+/**
+ * A local transform made of a translation, a rotation and a uniform scale.
+ *
+ * The setters take the double precision values of the simulation and store
+ * float matrices. Their product is cached and only recomputed by
+ * updateLocalMatrix() after a setter actually changed a value.
+ */
+class Transform
+{
+  public:
+    virtual ~Transform() = default;
+    void setPosition(const Vector3 &position);
+    void setRotation(const Vector3 &rotation);
+    void setRotation(const Matrix4 &rotation);
+    void setScale(const double scale);
+    bool updateLocalMatrix();
+    const Matrix4f &getLocalMatrix() const;
+
+  protected:
+    void invalidate();
+
+    Matrix4f position = Matrix4f::translate(0, 0, 0);
+    Matrix4f rotation = Matrix4f::rotateX(0);
+    Matrix4f scale = Matrix4f::scale(1);
+
+  private:
+    Vector3 rotationAngles = {0, 0, 0};
+    Matrix4f localMatrix = Matrix4f::scale(1);
+    bool localMatrixDirty = true;
+};
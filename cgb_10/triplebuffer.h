@@ -0,0 +1,83 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Hands the latest value from one writer thread to one reader thread
+ * without locks and without either side ever waiting for the other.
+ *
+ * Writer and reader each own one of three slots, the third one is exchanged
+ * atomically. The writer fills back() and publishes it, the reader takes the
+ * most recently published slot with fetch() and reads it through front().
+ * Values published in between are skipped. Slots are reused, so values that
+ * hold memory, like vectors, stop allocating once every slot has been
+ * written.
+ */
+template <typename T>
+class TripleBuffer
+{
+  public:
+    /**
+     * The slot the writer fills, not visible to the reader until publish().
+     */
+    T &back()
+    {
+        return slots[backIndex];
+    }
+
+    void publish()
+    {
+        uint8_t previous = middle.exchange(backIndex | fresh, std::memory_order_acq_rel);
+        backIndex = previous & indexMask;
+    }
+
+    /**
+     * The slot the reader owns, it keeps its content until the next fetch().
+     */
+    T &front()
+    {
+        return slots[frontIndex];
+    }
+
+    /**
+     * Makes the most recently published value the front.
+     *
+     * @return False if nothing was published since the last fetch.
+     */
+    bool fetch()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & fresh)) return false;
+
+        uint8_t previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & indexMask;
+        return true;
+    }
+
+  private:
+    static constexpr uint8_t indexMask = 3;
+    static constexpr uint8_t fresh = 4;
+
+    T slots[3];
+    uint8_t backIndex = 0;
+    std::atomic<uint8_t> middle = 1;
+    uint8_t frontIndex = 2;
+};
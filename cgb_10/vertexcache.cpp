@@ -0,0 +1,42 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "vertexcache.h"
+
+#include <algorithm>
+#include <deque>
+
+double computeAcmr(const std::vector<uint32_t> &indices, size_t cacheSize)
+{
+    if (indices.size() < 3) return 0.0;
+
+    std::deque<uint32_t> cache;
+    size_t misses = 0;
+
+    for (uint32_t index : indices)
+    {
+        if (std::find(cache.begin(), cache.end(), index) != cache.end()) continue;
+
+        misses++;
+        cache.push_back(index);
+        if (cache.size() > cacheSize) cache.pop_front();
+    }
+
+    return static_cast<double>(misses) / static_cast<double>(indices.size() / 3);
+}
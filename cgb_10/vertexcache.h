@@ -0,0 +1,36 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Simulates a FIFO post-transform vertex cache of the given size and returns
+ * the average cache miss ratio (ACMR), i.e. the number of vertices that have
+ * to be transformed per triangle. 3.0 means no reuse at all, values around
+ * 0.5 are close to the optimum for regular grids.
+ *
+ * @param indices Triangle list indices.
+ * @param cacheSize Number of entries of the simulated cache.
+ * @return The average number of cache misses per triangle.
+ */
+double computeAcmr(const std::vector<uint32_t> &indices, size_t cacheSize);
@@ -0,0 +1,737 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "virtualtexture.h"
+
+#include "extensions.h"
+#include "renderstate.h"
+#include "texture.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+
+/**
+ * Header of a .tiles file, all values in native byte order. The tiles follow
+ * at dataOffset without gaps, level after level starting with the largest,
+ * row after row starting at the bottom. Every tile is tileSize texels wide
+ * and high, including a border of texels repeated from its neighbors.
+ */
+struct TileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t tileSize;
+    uint32_t border;
+    uint32_t levels;
+    uint32_t dataOffset;
+};
+
+// Functions shared by the feedback pass and the shaders that sample the texture.
+// Tiles cover tileLayout.x minus twice the border texels tileLayout.y of their level.
+static const char *lookupSource = R"(
+uniform sampler2D pageTable;
+uniform vec2 virtualSize;
+uniform vec2 tileLayout;
+uniform float maxLevel;
+uniform float cacheSlots;
+uniform float lodBias;
+
+// Mipmap level as with GL_LINEAR_MIPMAP_NEAREST, from the texels of level 0 per pixel
+float virtualLevel(vec2 uv)
+{
+    vec2 dx = dFdx(uv * virtualSize);
+    vec2 dy = dFdy(uv * virtualSize);
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + lodBias;
+    return clamp(floor(lod + 0.5), 0.0, maxLevel);
+}
+
+vec2 virtualTile(vec2 uv, float level)
+{
+    return floor(clamp(uv, 0.0, 0.99999) * virtualSize / ((tileLayout.x - 2.0 * tileLayout.y) * exp2(level)));
+}
+
+// Position in the cache textures of uv, in the tile of the pixel's level or the coarser one standing in for it
+vec2 virtualCoordinate(vec2 uv)
+{
+    float level = virtualLevel(uv);
+    vec4 entry = floor(texelFetch(pageTable, ivec2(virtualTile(uv, level)), int(level)) * 255.0 + 0.5);
+    float content = tileLayout.x - 2.0 * tileLayout.y;
+    vec2 texel = clamp(uv, 0.0, 0.99999) * virtualSize / exp2(entry.b);
+    vec2 inTile = texel - floor(texel / content) * content + tileLayout.y;
+    return (entry.rg * tileLayout.x + inTile) / (cacheSlots * tileLayout.x);
+}
+)";
+
+static const char *feedbackVertexSource = R"(#version 130
+
+void main()
+{
+    gl_TexCoord[0] = gl_MultiTexCoord0;
+    gl_Position = ftransform();
+}
+)";
+
+// Tile coordinates have 12 bits, the upper 4 of both share the blue channel.
+// Alpha is the level plus one, zero where nothing was drawn.
+static const char *feedbackFragmentSource = R"(
+void main()
+{
+    vec2 uv = gl_TexCoord[0].st;
+    float level = virtualLevel(uv);
+    vec2 tile = virtualTile(uv, level);
+    vec2 high = floor(tile / 256.0);
+    gl_FragColor = vec4(tile - high * 256.0, high.x + high.y * 16.0, level + 1.0) / 255.0;
+}
+)";
+
+static int nextPowerOfTwo(int value)
+{
+    int result = 1;
+    while (result < value) result *= 2;
+    return result;
+}
+
+static std::vector<std::ifstream> openLayers(const std::vector<VirtualTexture::Layer> &layers)
+{
+    std::vector<std::ifstream> files;
+    for (const VirtualTexture::Layer &layer : layers)
+    {
+        files.emplace_back(layer.filename, std::ios::binary);
+        if (!files.back())
+        {
+            throw std::runtime_error("Failed to open " + layer.filename);
+        }
+    }
+    return files;
+}
+
+/**
+ * Reads the headers of the layers and sets up the cache, the page table and
+ * the feedback pass. The coarsest level is read right away.
+ *
+ * @param layers Files written by tilepack, all of the same size.
+ * @param cacheSize Width and height of the cache textures, which hold
+ *                  (cacheSize / tileSize)^2 tiles each.
+ * @param threadCount Number of worker threads, zero for one per core up to four.
+ */
+VirtualTexture::VirtualTexture(const std::vector<Layer> &layers, int cacheSize, unsigned threadCount)
+    : layers(layers)
+{
+    TRACE_ZONE("VirtualTexture::VirtualTexture");
+    if (layers.empty())
+    {
+        throw std::runtime_error("Virtual texture without layers");
+    }
+
+    for (const Layer &layer : layers)
+    {
+        TileHeader header;
+        std::ifstream file(layer.filename, std::ios::binary);
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || std::memcmp(header.magic, "CGBTILES", 8) != 0 || header.version != 1 ||
+            header.width == 0 || header.height == 0 || header.channels < 1 || header.channels > 4 || header.tileSize <= 2 * header.border ||
+            header.tileSize > 1024)
+        {
+            throw std::runtime_error("Invalid tile file " + layer.filename);
+        }
+        if (channels.empty())
+        {
+            width = static_cast<int>(header.width);
+            height = static_cast<int>(header.height);
+            tileSize = static_cast<int>(header.tileSize);
+            border = static_cast<int>(header.border);
+            levels = static_cast<int>(header.levels);
+        }
+        else if (static_cast<int>(header.width) != width || static_cast<int>(header.height) != height || static_cast<int>(header.tileSize) != tileSize ||
+                 static_cast<int>(header.border) != border || static_cast<int>(header.levels) != levels)
+        {
+            throw std::runtime_error("Tiles of " + layer.filename + " do not match " + layers.front().filename);
+        }
+        channels.push_back(static_cast<int>(header.channels));
+        dataOffsets.push_back(header.dataOffset);
+    }
+
+    // Levels go on until a single tile covers the texture, the feedback pass has 12 bits per tile coordinate
+    int expectedLevels = 1;
+    while (getTilesX(expectedLevels - 1) > 1 || getTilesY(expectedLevels - 1) > 1) expectedLevels++;
+    if (levels != expectedLevels || getTilesX(0) > 4096 || getTilesY(0) > 4096)
+    {
+        throw std::runtime_error("Invalid tile pyramid in " + layers.front().filename);
+    }
+    firstTiles.push_back(0);
+    for (int level = 0; level < levels; level++)
+    {
+        firstTiles.push_back(firstTiles.back() + static_cast<uint64_t>(getTilesX(level)) * getTilesY(level));
+    }
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        uint64_t size = dataOffsets[i] + firstTiles.back() * tileSize * tileSize * channels[i];
+        if (std::filesystem::file_size(layers[i].filename) < size)
+        {
+            throw std::runtime_error("Tile file " + layers[i].filename + " is truncated");
+        }
+    }
+
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    cacheSlots = std::clamp(std::min(cacheSize, static_cast<int>(maxTextureSize)) / tileSize, 1, 256);
+    slots.resize(static_cast<size_t>(cacheSlots) * cacheSlots);
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        GLuint cache;
+        glGenTextures(1, &cache);
+        RenderState::bindTexture(cache);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexImage2D(GL_TEXTURE_2D, 0, layers[i].internalFormat, cacheSlots * tileSize, cacheSlots * tileSize, 0, Texture::getPixelFormat(channels[i]),
+                     GL_UNSIGNED_BYTE, nullptr);
+        caches.push_back(cache);
+    }
+
+    // One texel per tile and level, each level of the pyramid is a mipmap level
+    pageTableWidth = nextPowerOfTwo(getTilesX(0));
+    pageTableHeight = nextPowerOfTwo(getTilesY(0));
+    glGenTextures(1, &pageTable);
+    RenderState::bindTexture(pageTable);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    pageEntries.resize(levels);
+    for (int level = 0; level < levels; level++)
+    {
+        int levelWidth = std::max(1, pageTableWidth >> level), levelHeight = std::max(1, pageTableHeight >> level);
+        pageEntries[level].assign(static_cast<size_t>(levelWidth) * levelHeight * 4, 0);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, levelWidth, levelHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pageEntries[level].data());
+    }
+
+    feedbackShader = std::make_unique<Shader>(feedbackVertexSource, std::string("#version 130\n") + lookupSource + feedbackFragmentSource);
+    GL::GenFramebuffers(1, &feedbackFramebuffer);
+    GL::GenRenderbuffers(2, feedbackAttachments);
+    GL::GenBuffers(2, feedbackBuffers);
+
+    // The coarsest level stands in for every tile that is not loaded, so it is never evicted
+    std::vector<std::ifstream> files = openLayers(layers);
+    for (int y = 0; y < getTilesY(levels - 1); y++)
+    {
+        for (int x = 0; x < getTilesX(levels - 1); x++)
+        {
+            Tile tile = {makeKey(levels - 1, x, y), {}, nullptr};
+            readTile(files, tile);
+            storeTile(tile, true);
+        }
+    }
+    updatePageTable();
+
+    if (threadCount == 0)
+    {
+        threadCount = std::clamp(std::thread::hardware_concurrency(), 1u, 4u);
+    }
+    for (unsigned i = 0; i < threadCount; i++)
+    {
+        workers.emplace_back(&VirtualTexture::run, this);
+    }
+}
+
+VirtualTexture::~VirtualTexture()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    requestedChanged.notify_all();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    for (GLsync fence : feedbackFences)
+    {
+        if (fence) GL::DeleteSync(fence);
+    }
+    GL::DeleteBuffers(2, feedbackBuffers);
+    GL::DeleteRenderbuffers(2, feedbackAttachments);
+    GL::DeleteFramebuffers(1, &feedbackFramebuffer);
+    glDeleteTextures(1, &pageTable);
+    glDeleteTextures(static_cast<GLsizei>(caches.size()), caches.data());
+    RenderState::invalidate();
+}
+
+/**
+ * Binds the cache textures of the layers to the first texture units and the
+ * page table to the unit after them, and sets the uniforms of the functions
+ * from getShaderSource(). The samplers of the layers are up to the caller.
+ */
+void VirtualTexture::bind(const Shader &shader) const
+{
+    GLenum pageTableUnit = GL_TEXTURE0 + static_cast<GLenum>(layers.size());
+    RenderState::setActiveTexture(pageTableUnit);
+    RenderState::bindTexture(pageTable);
+    for (size_t i = caches.size(); i-- > 0;)
+    {
+        RenderState::setActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
+        RenderState::bindTexture(caches[i]);
+    }
+    setUniforms(shader, 0.0f);
+    GL::Uniform1i(shader.getUniform("pageTable"), static_cast<GLint>(layers.size()));
+}
+
+void VirtualTexture::unbind() const
+{
+    for (size_t i = layers.size() + 1; i-- > 0;)
+    {
+        RenderState::setActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
+        RenderState::bindTexture(0);
+    }
+}
+
+/**
+ * Switches to the feedback framebuffer and shader, sized to a fraction of the
+ * current viewport. The matrices stay as they are, so the mesh is drawn as
+ * usual until endFeedback().
+ *
+ * @return False if the feedback is skipped this frame, because both pixel buffers are still waiting for update().
+ */
+bool VirtualTexture::beginFeedback()
+{
+    if (feedbackPending[feedbackNext]) return false;
+
+    TRACE_ZONE("VirtualTexture::beginFeedback");
+    glGetIntegerv(GL_VIEWPORT, savedViewport);
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &savedFramebuffer);
+    int viewportWidth = std::max(1, savedViewport[2] / feedbackScale), viewportHeight = std::max(1, savedViewport[3] / feedbackScale);
+    if (viewportWidth != feedbackWidth || viewportHeight != feedbackHeight)
+    {
+        createFeedbackBuffers(viewportWidth, viewportHeight);
+    }
+
+    GL::BindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+    glViewport(0, 0, feedbackWidth, feedbackHeight);
+    GLfloat clearColor[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+
+    // Derivatives are feedbackScale times larger than in the full viewport
+    feedbackShader->use();
+    setUniforms(*feedbackShader, -std::log2(static_cast<float>(feedbackScale)));
+    return true;
+}
+
+/**
+ * Starts reading back the feedback pass and switches back to the previous
+ * framebuffer, viewport and the fixed-function pipeline.
+ */
+void VirtualTexture::endFeedback()
+{
+    GL::BindBuffer(GL_PIXEL_PACK_BUFFER, feedbackBuffers[feedbackNext]);
+    glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    GL::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (GL::hasSync())
+    {
+        feedbackFences[feedbackNext] = GL::FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    feedbackPending[feedbackNext] = true;
+    feedbackNext = 1 - feedbackNext;
+
+    Shader::useFixedFunction();
+    GL::BindFramebuffer(GL_FRAMEBUFFER, savedFramebuffer);
+    glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+}
+
+/**
+ * Requests the tiles of the feedback passes that have been read back and
+ * copies loaded tiles into the cache until the budget in seconds is used up.
+ * Has to be called on the thread that owns the OpenGL context.
+ */
+void VirtualTexture::update(double budget)
+{
+    TRACE_ZONE("VirtualTexture::update");
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(budget));
+    readFeedback(false);
+    {
+        std::unique_lock lock(mutex);
+        storeLoaded(lock, deadline);
+        statistics.pending = static_cast<uint32_t>(requested.size() + loading.size());
+    }
+    if (pageTableChanged) updatePageTable();
+    statistics.resident = static_cast<uint32_t>(resident.size());
+}
+
+/**
+ * Waits for the feedback passes drawn so far and loads all tiles they need
+ * without a time limit, so the next frame does not depend on timing.
+ */
+void VirtualTexture::finish()
+{
+    TRACE_ZONE("VirtualTexture::finish");
+    readFeedback(true);
+    {
+        std::unique_lock lock(mutex);
+        while (!requested.empty() || !loading.empty())
+        {
+            loadedChanged.wait(lock, [this] { return !loaded.empty(); });
+            storeLoaded(lock, std::chrono::steady_clock::time_point::max());
+        }
+        statistics.pending = 0;
+    }
+    if (pageTableChanged) updatePageTable();
+    statistics.resident = static_cast<uint32_t>(resident.size());
+}
+
+/**
+ * Virtual textures sample the page table with texelFetch() and render the
+ * feedback pass into a framebuffer object read back through a pixel buffer.
+ */
+bool VirtualTexture::isSupported()
+{
+    return GL::hasTextureFetch() && GL::hasFramebuffers() && GL::hasPixelBuffers();
+}
+
+/**
+ * GLSL 1.30 functions for shaders that sample a virtual texture, to be
+ * inserted after the version directive. virtualCoordinate() maps texture
+ * coordinates to the cache textures, which are then sampled with
+ * textureLod() at level 0.
+ */
+const char *VirtualTexture::getShaderSource()
+{
+    return lookupSource;
+}
+
+const VirtualTexture::Statistics &VirtualTexture::getStatistics()
+{
+    return statistics;
+}
+
+uint32_t VirtualTexture::makeKey(int level, int x, int y)
+{
+    return static_cast<uint32_t>(level) << 24 | static_cast<uint32_t>(y) << 12 | static_cast<uint32_t>(x);
+}
+
+int VirtualTexture::getTilesX(int level) const
+{
+    int64_t coverage = static_cast<int64_t>(tileSize - 2 * border) << level;
+    return static_cast<int>((width + coverage - 1) / coverage);
+}
+
+int VirtualTexture::getTilesY(int level) const
+{
+    int64_t coverage = static_cast<int64_t>(tileSize - 2 * border) << level;
+    return static_cast<int>((height + coverage - 1) / coverage);
+}
+
+/**
+ * Reads the tile of every layer from the files opened by openLayers().
+ */
+void VirtualTexture::readTile(std::vector<std::ifstream> &files, Tile &tile) const
+{
+    int level = static_cast<int>(tile.key >> 24), y = static_cast<int>(tile.key >> 12 & 0xFFF), x = static_cast<int>(tile.key & 0xFFF);
+    uint64_t index = firstTiles[level] + static_cast<uint64_t>(y) * getTilesX(level) + x;
+    tile.layers.resize(layers.size());
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        size_t size = static_cast<size_t>(tileSize) * tileSize * channels[i];
+        tile.layers[i].resize(size);
+        files[i].seekg(static_cast<std::streamoff>(dataOffsets[i] + index * size));
+        if (!files[i].read(reinterpret_cast<char *>(tile.layers[i].data()), static_cast<std::streamsize>(size)))
+        {
+            throw std::runtime_error("Failed to read tile from " + layers[i].filename);
+        }
+    }
+}
+
+/**
+ * Copies the tile into the slot used least recently. Tiles that were needed
+ * by the latest feedback pass are not replaced, if all slots hold such tiles
+ * the new one is dropped and the coarser one keeps standing in for it.
+ *
+ * @param pin Never evicts the tile.
+ */
+void VirtualTexture::storeTile(const Tile &tile, bool pin)
+{
+    int slot = -1;
+    uint32_t oldest = frame;
+    for (size_t i = 0; i < slots.size() && oldest > 0; i++)
+    {
+        if (slots[i].lastUsed < oldest)
+        {
+            oldest = slots[i].lastUsed;
+            slot = static_cast<int>(i);
+        }
+    }
+    if (slot < 0) return;
+
+    if (slots[slot].key != noTile) resident.erase(slots[slot].key);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        RenderState::bindTexture(caches[i]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, slot % cacheSlots * tileSize, slot / cacheSlots * tileSize, tileSize, tileSize,
+                        Texture::getPixelFormat(channels[i]), GL_UNSIGNED_BYTE, tile.layers[i].data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    slots[slot] = {tile.key, pin ? pinned : frame};
+    resident[tile.key] = slot;
+    pageTableChanged = true;
+}
+
+/**
+ * Stores tiles read by the workers in the order they finished until the
+ * deadline. Errors of the workers are thrown here.
+ */
+void VirtualTexture::storeLoaded(std::unique_lock<std::mutex> &lock, std::chrono::steady_clock::time_point deadline)
+{
+    while (!loaded.empty() && std::chrono::steady_clock::now() < deadline)
+    {
+        std::unique_ptr<Tile> tile = std::move(loaded.front());
+        loaded.pop_front();
+        loading.erase(tile->key);
+        requestedChanged.notify_all();
+        if (tile->error) std::rethrow_exception(tile->error);
+
+        lock.unlock();
+        storeTile(*tile);
+        lock.lock();
+    }
+}
+
+/**
+ * Maps the pixel buffers of feedback passes, oldest first, and requests the
+ * tiles they show.
+ *
+ * @param wait Also waits for passes the GPU has not finished, otherwise only
+ *             reads those known to be finished, or without fences the one
+ *             from the frame before.
+ */
+void VirtualTexture::readFeedback(bool wait)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        int buffer = (feedbackNext + i) % 2;
+        if (!feedbackPending[buffer]) continue;
+        if (!wait)
+        {
+            GLsync fence = feedbackFences[buffer];
+            GLenum status = fence ? GL::ClientWaitSync(fence, 0, 0) : 0;
+            bool finished = fence ? status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED : buffer == feedbackNext;
+            if (!finished) break;
+        }
+
+        GL::BindBuffer(GL_PIXEL_PACK_BUFFER, feedbackBuffers[buffer]);
+        auto pixels = static_cast<const unsigned char *>(GL::MapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+        if (pixels)
+        {
+            requestVisible(pixels, static_cast<size_t>(feedbackWidth) * feedbackHeight);
+            GL::UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        GL::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (feedbackFences[buffer])
+        {
+            GL::DeleteSync(feedbackFences[buffer]);
+            feedbackFences[buffer] = nullptr;
+        }
+        feedbackPending[buffer] = false;
+    }
+}
+
+/**
+ * Marks the tiles in the feedback pixels and all coarser tiles above them as
+ * used and requests those that are missing, coarse levels first. Requests of
+ * earlier passes that no worker has started on are dropped.
+ */
+void VirtualTexture::requestVisible(const unsigned char *pixels, size_t count)
+{
+    TRACE_ZONE("VirtualTexture::requestVisible");
+    frame++;
+    std::unordered_set<uint32_t> needed;
+    std::vector<uint32_t> missing;
+    uint32_t previous = noTile;
+    for (size_t i = 0; i < count; i++)
+    {
+        const unsigned char *pixel = pixels + i * 4;
+        if (pixel[3] == 0) continue;
+        int level = pixel[3] - 1, x = pixel[0] | (pixel[2] & 0xF) << 8, y = pixel[1] | (pixel[2] >> 4) << 8;
+        uint32_t key = makeKey(level, x, y);
+        if (key == previous || level >= levels || x >= getTilesX(level) || y >= getTilesY(level)) continue;
+        previous = key;
+
+        // Stops at the first tile that was already handled, its coarser tiles have been too
+        while (needed.insert(key).second)
+        {
+            auto found = resident.find(key);
+            if (found == resident.end())
+            {
+                missing.push_back(key);
+            }
+            else if (slots[found->second].lastUsed != pinned)
+            {
+                slots[found->second].lastUsed = frame;
+            }
+            if (++level == levels) break;
+            x /= 2;
+            y /= 2;
+            key = makeKey(level, x, y);
+        }
+    }
+
+    // The level is in the upper bits, more tiles than fit into the cache would only evict each other
+    std::sort(missing.begin(), missing.end(), std::greater<uint32_t>());
+    missing.resize(std::min(missing.size(), slots.size()));
+    {
+        std::lock_guard lock(mutex);
+        requested.clear();
+        for (uint32_t key : missing)
+        {
+            if (!loading.count(key)) requested.push_back(key);
+        }
+    }
+    requestedChanged.notify_all();
+}
+
+/**
+ * Points every texel of the page table to the slot of its tile or of the
+ * nearest coarser tile that is loaded.
+ */
+void VirtualTexture::updatePageTable()
+{
+    TRACE_ZONE("VirtualTexture::updatePageTable");
+    RenderState::bindTexture(pageTable);
+    for (int level = levels - 1; level >= 0; level--)
+    {
+        int levelWidth = std::max(1, pageTableWidth >> level), levelHeight = std::max(1, pageTableHeight >> level);
+        int parentWidth = std::max(1, pageTableWidth >> (level + 1));
+        std::vector<unsigned char> &entries = pageEntries[level];
+        for (int y = 0; y < getTilesY(level); y++)
+        {
+            for (int x = 0; x < getTilesX(level); x++)
+            {
+                unsigned char *entry = &entries[(static_cast<size_t>(y) * levelWidth + x) * 4];
+                auto found = resident.find(makeKey(level, x, y));
+                if (found == resident.end())
+                {
+                    std::memcpy(entry, &pageEntries[level + 1][(static_cast<size_t>(y / 2) * parentWidth + x / 2) * 4], 4);
+                    continue;
+                }
+                entry[0] = static_cast<unsigned char>(found->second % cacheSlots);
+                entry[1] = static_cast<unsigned char>(found->second / cacheSlots);
+                entry[2] = static_cast<unsigned char>(level);
+                entry[3] = 255;
+            }
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, levelWidth, levelHeight, GL_RGBA, GL_UNSIGNED_BYTE, entries.data());
+    }
+    pageTableChanged = false;
+}
+
+void VirtualTexture::setUniforms(const Shader &shader, float lodBias) const
+{
+    GL::Uniform2f(shader.getUniform("virtualSize"), static_cast<float>(width), static_cast<float>(height));
+    GL::Uniform2f(shader.getUniform("tileLayout"), static_cast<float>(tileSize), static_cast<float>(border));
+    GL::Uniform1f(shader.getUniform("maxLevel"), static_cast<float>(levels - 1));
+    GL::Uniform1f(shader.getUniform("cacheSlots"), static_cast<float>(cacheSlots));
+    GL::Uniform1f(shader.getUniform("lodBias"), lodBias);
+}
+
+/**
+ * Sizes the attachments of the feedback framebuffer and the pixel buffers.
+ * Passes that have not been read back yet are dropped.
+ */
+void VirtualTexture::createFeedbackBuffers(int width, int height)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (feedbackFences[i]) GL::DeleteSync(feedbackFences[i]);
+        feedbackFences[i] = nullptr;
+        feedbackPending[i] = false;
+    }
+
+    GL::BindRenderbuffer(GL_RENDERBUFFER, feedbackAttachments[0]);
+    GL::RenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    GL::BindRenderbuffer(GL_RENDERBUFFER, feedbackAttachments[1]);
+    GL::RenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    GL::BindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GL::BindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+    GL::FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, feedbackAttachments[0]);
+    GL::FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackAttachments[1]);
+    GLenum status = GL::CheckFramebufferStatus(GL_FRAMEBUFFER);
+    GL::BindFramebuffer(GL_FRAMEBUFFER, savedFramebuffer);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::runtime_error("Failed to create feedback framebuffer");
+    }
+
+    for (GLuint buffer : feedbackBuffers)
+    {
+        GL::BindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        GL::BufferData(GL_PIXEL_PACK_BUFFER, static_cast<ptrdiff_t>(width) * height * 4, nullptr, GL_STREAM_READ);
+    }
+    GL::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    feedbackWidth = width;
+    feedbackHeight = height;
+}
+
+/**
+ * Reads requested tiles, as long as fewer than maxLoadedTiles wait to be
+ * stored, so the memory for tiles in flight is bounded too.
+ */
+void VirtualTexture::run()
+{
+    TRACE_THREAD("tile loader");
+    std::vector<std::ifstream> files;
+    std::unique_lock lock(mutex);
+    while (true)
+    {
+        requestedChanged.wait(lock, [this] { return stopping || (!requested.empty() && loaded.size() + reading < maxLoadedTiles); });
+        if (stopping) return;
+
+        auto tile = std::make_unique<Tile>();
+        tile->key = requested.front();
+        requested.pop_front();
+        loading.insert(tile->key);
+        reading++;
+        lock.unlock();
+        try
+        {
+            TRACE_ZONE("VirtualTexture::readTile");
+            if (files.empty()) files = openLayers(layers);
+            readTile(files, *tile);
+        }
+        catch (...)
+        {
+            tile->error = std::current_exception();
+        }
+        lock.lock();
+        reading--;
+        loaded.push_back(std::move(tile));
+        loadedChanged.notify_all();
+    }
+}
@@ -0,0 +1,165 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "shader.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * A texture of any size, cut into tiles of a mipmap pyramid by the tilepack
+ * tool, of which only the visible ones are kept on the GPU.
+ *
+ * The tiles are kept in a cache texture with a fixed number of slots. A page
+ * table with one texel per tile and level tells shaders which slot holds a
+ * tile or, while it is not loaded, the nearest coarser one. Which tiles are
+ * needed comes from a feedback pass: between beginFeedback() and
+ * endFeedback() the mesh is drawn into a small framebuffer, where every pixel
+ * stores the tile and level it samples, and read back a frame later.
+ *
+ * Missing tiles are read by worker threads, coarse levels first, and copied
+ * into the cache by update() within a time budget. The tiles used least
+ * recently make room for them, so memory stays the same however large the
+ * texture is. The coarsest level is always loaded.
+ *
+ * Several layers of the same size share the page table and the slots, a
+ * shader samples all of them at the coordinate from virtualCoordinate(),
+ * see getShaderSource(). Needs OpenGL 3.0, check isSupported() first.
+ */
+class VirtualTexture
+{
+  public:
+    struct Layer
+    {
+        std::string filename;
+        GLint internalFormat;
+    };
+
+    struct Statistics
+    {
+        uint32_t resident;
+        uint32_t pending;
+    };
+
+    VirtualTexture(const std::vector<Layer> &layers, int cacheSize = 4096, unsigned threadCount = 0);
+    VirtualTexture(const VirtualTexture &) = delete;
+    VirtualTexture &operator=(const VirtualTexture &) = delete;
+    ~VirtualTexture();
+    void bind(const Shader &shader) const;
+    void unbind() const;
+    bool beginFeedback();
+    void endFeedback();
+    void update(double budget);
+    void finish();
+    static bool isSupported();
+    static const char *getShaderSource();
+    static const Statistics &getStatistics();
+
+  private:
+    static constexpr int feedbackScale = 8;
+    static constexpr size_t maxLoadedTiles = 16;
+    static constexpr uint32_t noTile = 0xFFFFFFFF;
+    static constexpr uint32_t pinned = 0xFFFFFFFF;
+
+    struct Tile
+    {
+        uint32_t key;
+        std::vector<std::vector<unsigned char>> layers;
+        std::exception_ptr error;
+    };
+
+    struct Slot
+    {
+        uint32_t key = noTile;
+        uint32_t lastUsed = 0;
+    };
+
+    static uint32_t makeKey(int level, int x, int y);
+    int getTilesX(int level) const;
+    int getTilesY(int level) const;
+    void readTile(std::vector<std::ifstream> &files, Tile &tile) const;
+    void storeTile(const Tile &tile, bool pin = false);
+    void storeLoaded(std::unique_lock<std::mutex> &lock, std::chrono::steady_clock::time_point deadline);
+    void readFeedback(bool wait);
+    void requestVisible(const unsigned char *pixels, size_t count);
+    void updatePageTable();
+    void setUniforms(const Shader &shader, float lodBias) const;
+    void createFeedbackBuffers(int width, int height);
+    void run();
+
+    std::vector<Layer> layers;
+    std::vector<int> channels;
+    int width = 0;
+    int height = 0;
+    int levels = 0;
+    int tileSize = 0;
+    int border = 0;
+    std::vector<uint32_t> dataOffsets;
+    std::vector<uint64_t> firstTiles;
+
+    // Cache textures and page table, only touched by the thread that owns the context
+    std::vector<GLuint> caches;
+    int cacheSlots = 0;
+    std::vector<Slot> slots;
+    std::unordered_map<uint32_t, int> resident;
+    GLuint pageTable = 0;
+    int pageTableWidth = 0;
+    int pageTableHeight = 0;
+    std::vector<std::vector<unsigned char>> pageEntries;
+    bool pageTableChanged = false;
+    uint32_t frame = 1;
+
+    // Feedback pass, read back through two pixel buffers in turn
+    std::unique_ptr<Shader> feedbackShader;
+    GLuint feedbackFramebuffer = 0;
+    GLuint feedbackAttachments[2] = {0, 0};
+    GLuint feedbackBuffers[2] = {0, 0};
+    GLsync feedbackFences[2] = {nullptr, nullptr};
+    bool feedbackPending[2] = {false, false};
+    int feedbackNext = 0;
+    int feedbackWidth = 0;
+    int feedbackHeight = 0;
+    GLint savedFramebuffer = 0;
+    GLint savedViewport[4] = {};
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable requestedChanged;
+    std::condition_variable loadedChanged;
+    std::deque<uint32_t> requested;
+    std::unordered_set<uint32_t> loading;
+    std::deque<std::unique_ptr<Tile>> loaded;
+    size_t reading = 0;
+    bool stopping = false;
+
+    static inline Statistics statistics = {};
+};
@@ -0,0 +1,393 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "blockcompression.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define BLOCKCOMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace BlockCompression
+{
+    /** The 16 pixels of a block, one array per channel. */
+    struct Block
+    {
+        float r[16];
+        float g[16];
+        float b[16];
+    };
+
+    // Index selection, the part of the encoder that runs once per pixel. The
+    // scalar versions are only used where SSE2 is missing.
+
+    /**
+     * Projects every pixel onto the line between the two colors and rounds to
+     * the nearest of the four palette entries. BC1 numbers them c0, c1, 2/3 c0
+     * + 1/3 c1 and 1/3 c0 + 2/3 c1, so the position on the line is remapped.
+     */
+    [[maybe_unused]] static uint32_t selectIndicesBC1Scalar(const Block &block, const float *c0, const float *c1)
+    {
+        static const uint32_t remap[4] = {1, 3, 2, 0};
+        float axis[3] = {c0[0] - c1[0], c0[1] - c1[1], c0[2] - c1[2]};
+        float scale = 3.0f / (axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        for (float &a : axis) a *= scale;
+
+        uint32_t indices = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = (block.r[i] - c1[0]) * axis[0];
+            t = t + (block.g[i] - c1[1]) * axis[1];
+            t = t + (block.b[i] - c1[2]) * axis[2];
+            int position = static_cast<int>(std::clamp(t + 0.5f, 0.0f, 3.0f));
+            indices |= remap[position] << (2 * i);
+        }
+        return indices;
+    }
+
+    /**
+     * Rounds every value to the nearest step of the ramp from r1 to r0. BC4
+     * numbers them r0, r1, then the six steps from r0 towards r1.
+     */
+    [[maybe_unused]] static uint64_t selectIndicesBC4Scalar(const float *values, float r0, float r1)
+    {
+        static const uint64_t remap[8] = {1, 7, 6, 5, 4, 3, 2, 0};
+        float scale = 7.0f / (r0 - r1);
+
+        uint64_t indices = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            int position = static_cast<int>(std::clamp((values[i] - r1) * scale + 0.5f, 0.0f, 7.0f));
+            indices |= remap[position] << (3 * i);
+        }
+        return indices;
+    }
+
+#if defined(BLOCKCOMPRESSION_SSE2)
+
+    // SSE2, four pixels per register
+
+    static uint32_t selectIndicesBC1SSE2(const Block &block, const float *c0, const float *c1)
+    {
+        static const uint32_t remap[4] = {1, 3, 2, 0};
+        float axis[3] = {c0[0] - c1[0], c0[1] - c1[1], c0[2] - c1[2]};
+        float scale = 3.0f / (axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+
+        __m128 axisR = _mm_set1_ps(axis[0] * scale);
+        __m128 axisG = _mm_set1_ps(axis[1] * scale);
+        __m128 axisB = _mm_set1_ps(axis[2] * scale);
+        __m128 originR = _mm_set1_ps(c1[0]);
+        __m128 originG = _mm_set1_ps(c1[1]);
+        __m128 originB = _mm_set1_ps(c1[2]);
+        __m128 half = _mm_set1_ps(0.5f);
+        __m128 zero = _mm_setzero_ps();
+        __m128 last = _mm_set1_ps(3.0f);
+
+        uint32_t indices = 0;
+        for (int i = 0; i < 16; i += 4)
+        {
+            __m128 t = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(block.r + i), originR), axisR);
+            t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(block.g + i), originG), axisG));
+            t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(block.b + i), originB), axisB));
+            t = _mm_min_ps(_mm_max_ps(_mm_add_ps(t, half), zero), last);
+
+            alignas(16) int32_t positions[4];
+            _mm_store_si128(reinterpret_cast<__m128i *>(positions), _mm_cvttps_epi32(t));
+            for (int j = 0; j < 4; j++)
+            {
+                indices |= remap[positions[j]] << (2 * (i + j));
+            }
+        }
+        return indices;
+    }
+
+    static uint64_t selectIndicesBC4SSE2(const float *values, float r0, float r1)
+    {
+        static const uint64_t remap[8] = {1, 7, 6, 5, 4, 3, 2, 0};
+        __m128 scale = _mm_set1_ps(7.0f / (r0 - r1));
+        __m128 origin = _mm_set1_ps(r1);
+        __m128 half = _mm_set1_ps(0.5f);
+        __m128 zero = _mm_setzero_ps();
+        __m128 last = _mm_set1_ps(7.0f);
+
+        uint64_t indices = 0;
+        for (int i = 0; i < 16; i += 4)
+        {
+            __m128 t = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(values + i), origin), scale), half);
+            t = _mm_min_ps(_mm_max_ps(t, zero), last);
+
+            alignas(16) int32_t positions[4];
+            _mm_store_si128(reinterpret_cast<__m128i *>(positions), _mm_cvttps_epi32(t));
+            for (int j = 0; j < 4; j++)
+            {
+                indices |= remap[positions[j]] << (3 * (i + j));
+            }
+        }
+        return indices;
+    }
+
+    static uint32_t (*const selectIndicesBC1)(const Block &, const float *, const float *) = selectIndicesBC1SSE2;
+    static uint64_t (*const selectIndicesBC4)(const float *, float, float) = selectIndicesBC4SSE2;
+#else
+    static uint32_t (*const selectIndicesBC1)(const Block &, const float *, const float *) = selectIndicesBC1Scalar;
+    static uint64_t (*const selectIndicesBC4)(const float *, float, float) = selectIndicesBC4Scalar;
+#endif
+
+    // Endpoints
+
+    static uint16_t packColor(const float *color)
+    {
+        int r = std::clamp(static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+        int g = std::clamp(static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+        int b = std::clamp(static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+        return static_cast<uint16_t>(r << 11 | g << 5 | b);
+    }
+
+    static void unpackColor(uint16_t packed, float *color)
+    {
+        int r = packed >> 11 & 31, g = packed >> 5 & 63, b = packed & 31;
+        color[0] = static_cast<float>(r << 3 | r >> 2);
+        color[1] = static_cast<float>(g << 2 | g >> 4);
+        color[2] = static_cast<float>(b << 3 | b >> 2);
+    }
+
+    /**
+     * Fits a line through the colors of the block along their principal
+     * axis, which is found by power iteration on the covariance matrix. The
+     * end points are the outermost projections, moved inwards a little as
+     * the extremes are rarely hit exactly.
+     */
+    static void encodeBlockBC1(const Block &block, uint8_t *output)
+    {
+        float mean[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; i++)
+        {
+            mean[0] += block.r[i];
+            mean[1] += block.g[i];
+            mean[2] += block.b[i];
+        }
+        for (float &m : mean) m /= 16.0f;
+
+        float covariance[6] = {};
+        for (int i = 0; i < 16; i++)
+        {
+            float r = block.r[i] - mean[0], g = block.g[i] - mean[1], b = block.b[i] - mean[2];
+            covariance[0] += r * r;
+            covariance[1] += r * g;
+            covariance[2] += r * b;
+            covariance[3] += g * g;
+            covariance[4] += g * b;
+            covariance[5] += b * b;
+        }
+
+        float axis[3] = {1.0f, 1.0f, 1.0f};
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+            float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+            float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+            float length = std::max({std::fabs(x), std::fabs(y), std::fabs(z)});
+            if (length < 1e-6f) break;
+            axis[0] = x / length;
+            axis[1] = y / length;
+            axis[2] = z / length;
+        }
+
+        float minimum = 0.0f, maximum = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = (block.r[i] - mean[0]) * axis[0] + (block.g[i] - mean[1]) * axis[1] + (block.b[i] - mean[2]) * axis[2];
+            minimum = std::min(minimum, t);
+            maximum = std::max(maximum, t);
+        }
+        float inset = (maximum - minimum) / 16.0f;
+        minimum += inset;
+        maximum -= inset;
+
+        float high[3], low[3];
+        for (int c = 0; c < 3; c++)
+        {
+            high[c] = mean[c] + axis[c] * maximum;
+            low[c] = mean[c] + axis[c] * minimum;
+        }
+        uint16_t color0 = packColor(high);
+        uint16_t color1 = packColor(low);
+
+        // The four color mode needs color0 > color1, equal colors need no indices
+        if (color0 < color1) std::swap(color0, color1);
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            float c0[3], c1[3];
+            unpackColor(color0, c0);
+            unpackColor(color1, c1);
+            indices = selectIndicesBC1(block, c0, c1);
+        }
+
+        output[0] = static_cast<uint8_t>(color0);
+        output[1] = static_cast<uint8_t>(color0 >> 8);
+        output[2] = static_cast<uint8_t>(color1);
+        output[3] = static_cast<uint8_t>(color1 >> 8);
+        for (int i = 0; i < 4; i++)
+        {
+            output[4 + i] = static_cast<uint8_t>(indices >> (8 * i));
+        }
+    }
+
+    /**
+     * Uses the smallest and largest value as end points of the ramp, in the
+     * order that selects the eight value mode.
+     */
+    static void encodeBlockBC4(const float *values, uint8_t *output)
+    {
+        float minimum = *std::min_element(values, values + 16);
+        float maximum = *std::max_element(values, values + 16);
+        uint8_t r0 = static_cast<uint8_t>(maximum);
+        uint8_t r1 = static_cast<uint8_t>(minimum);
+
+        uint64_t indices = r0 > r1 ? selectIndicesBC4(values, r0, r1) : 0;
+        output[0] = r0;
+        output[1] = r1;
+        for (int i = 0; i < 6; i++)
+        {
+            output[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+        }
+    }
+
+    /**
+     * Size of an image in blocks of 8 bytes, partial blocks are padded.
+     */
+    size_t getSize(int width, int height)
+    {
+        return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+    }
+
+    /**
+     * Compresses an image stored row by row, top row first, as DDS expects
+     * it. The rows of blocks are shared out among the threads. Pixels beyond
+     * the edge repeat the last row or column.
+     *
+     * @param channels Channels per pixel. BC1 uses the first three, or the
+     *                 only one as gray, BC4 only ever the first.
+     */
+    std::vector<uint8_t> encode(Format format, const uint8_t *pixels, int width, int height, int channels, unsigned threadCount)
+    {
+        int blocksX = (width + 3) / 4;
+        int blocksY = (height + 3) / 4;
+        std::vector<uint8_t> output(getSize(width, height));
+
+        std::atomic<int> nextRow = 0;
+        auto encodeRows = [&]()
+        {
+            for (int blockY = nextRow++; blockY < blocksY; blockY = nextRow++)
+            {
+                for (int blockX = 0; blockX < blocksX; blockX++)
+                {
+                    Block block;
+                    for (int i = 0; i < 16; i++)
+                    {
+                        int x = std::min(blockX * 4 + i % 4, width - 1);
+                        int y = std::min(blockY * 4 + i / 4, height - 1);
+                        const uint8_t *pixel = pixels + (static_cast<size_t>(y) * width + x) * channels;
+                        block.r[i] = pixel[0];
+                        block.g[i] = channels >= 3 ? pixel[1] : pixel[0];
+                        block.b[i] = channels >= 3 ? pixel[2] : pixel[0];
+                    }
+
+                    uint8_t *destination = output.data() + (static_cast<size_t>(blockY) * blocksX + blockX) * blockSize;
+                    if (format == Format::BC1)
+                    {
+                        encodeBlockBC1(block, destination);
+                    }
+                    else
+                    {
+                        encodeBlockBC4(block.r, destination);
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned i = 1; i < threadCount; i++)
+        {
+            threads.emplace_back(encodeRows);
+        }
+        encodeRows();
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+        return output;
+    }
+
+    /**
+     * Expands compressed blocks again, to three channels for BC1 and one
+     * for BC4, for measuring the error of encode().
+     */
+    std::vector<uint8_t> decode(Format format, const uint8_t *blocks, int width, int height)
+    {
+        int channels = format == Format::BC1 ? 3 : 1;
+        int blocksX = (width + 3) / 4;
+        std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * channels);
+
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                const uint8_t *block = blocks + (static_cast<size_t>(y / 4) * blocksX + x / 4) * blockSize;
+                int i = (y % 4) * 4 + x % 4;
+                uint8_t *pixel = pixels.data() + (static_cast<size_t>(y) * width + x) * channels;
+
+                if (format == Format::BC1)
+                {
+                    float c0[3], c1[3];
+                    uint16_t color0 = static_cast<uint16_t>(block[0] | block[1] << 8);
+                    uint16_t color1 = static_cast<uint16_t>(block[2] | block[3] << 8);
+                    unpackColor(color0, c0);
+                    unpackColor(color1, c1);
+                    int index = block[4 + i / 4] >> (2 * (i % 4)) & 3;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        float value = index == 0 ? c0[c] : index == 1 ? c1[c] : index == 2 ? (2 * c0[c] + c1[c]) / 3 : (c0[c] + 2 * c1[c]) / 3;
+                        if (color0 <= color1 && index >= 2) value = index == 2 ? (c0[c] + c1[c]) / 2 : 0.0f;
+                        pixel[c] = static_cast<uint8_t>(value + 0.5f);
+                    }
+                }
+                else
+                {
+                    int r0 = block[0], r1 = block[1];
+                    uint64_t indices = 0;
+                    for (int b = 0; b < 6; b++) indices |= static_cast<uint64_t>(block[2 + b]) << (8 * b);
+                    int index = static_cast<int>(indices >> (3 * i) & 7);
+                    int value;
+                    if (index < 2) value = index == 0 ? r0 : r1;
+                    else if (r0 > r1) value = ((8 - index) * r0 + (index - 1) * r1 + 3) / 7;
+                    else value = index == 6 ? 0 : index == 7 ? 255 : ((6 - index) * r0 + (index - 1) * r1 + 2) / 5;
+                    pixel[0] = static_cast<uint8_t>(value);
+                }
+            }
+        }
+        return pixels;
+    }
+}
@@ -0,0 +1,48 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * S3TC block compression, as read by OpenGL from DDS files.
+ *
+ * Both formats split the image into blocks of 4x4 pixels. A BC1 block
+ * stores two RGB565 colors and a 2 bit index per pixel into these colors
+ * and two colors in between, 8 bytes for 16 pixels. A BC4 block stores two
+ * 8 bit values and a 3 bit index per pixel into a ramp of eight values
+ * between them, also 8 bytes, but for a single channel.
+ */
+namespace BlockCompression
+{
+    enum class Format
+    {
+        BC1,
+        BC4
+    };
+
+    static constexpr size_t blockSize = 8;
+
+    size_t getSize(int width, int height);
+    std::vector<uint8_t> encode(Format format, const uint8_t *pixels, int width, int height, int channels, unsigned threadCount);
+    std::vector<uint8_t> decode(Format format, const uint8_t *blocks, int width, int height);
+}
@@ -0,0 +1,249 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "blockcompression.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using BlockCompression::Format;
+
+/**
+ * Header of a DDS file as written by DirectX, all values little endian.
+ */
+struct DDSHeader
+{
+    uint32_t size = 124;
+    uint32_t flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;
+    uint32_t height = 0;
+    uint32_t width = 0;
+    uint32_t linearSize = 0;
+    uint32_t depth = 0;
+    uint32_t mipMapCount = 0;
+    uint32_t reserved1[11] = {};
+    uint32_t pixelFormatSize = 32;
+    uint32_t pixelFormatFlags = 0x4;
+    char fourCC[4] = {};
+    uint32_t pixelFormatUnused[5] = {};
+    uint32_t caps = 0x1000 | 0x8 | 0x400000;
+    uint32_t caps2 = 0;
+    uint32_t reserved2[3] = {};
+};
+
+static_assert(sizeof(DDSHeader) == 124, "DDSHeader must match the file layout");
+
+struct Image
+{
+    int width;
+    int height;
+    int channels;
+    std::vector<uint8_t> pixels;
+};
+
+/**
+ * Halves the image with a box filter. Odd sizes repeat the last row or column.
+ */
+static Image downsample(const Image &image)
+{
+    Image result{std::max(1, image.width / 2), std::max(1, image.height / 2), image.channels, {}};
+    result.pixels.resize(static_cast<size_t>(result.width) * result.height * result.channels);
+    for (int y = 0; y < result.height; y++)
+    {
+        int y0 = std::min(y * 2, image.height - 1), y1 = std::min(y * 2 + 1, image.height - 1);
+        for (int x = 0; x < result.width; x++)
+        {
+            int x0 = std::min(x * 2, image.width - 1), x1 = std::min(x * 2 + 1, image.width - 1);
+            for (int c = 0; c < image.channels; c++)
+            {
+                auto at = [&](int sx, int sy) { return image.pixels[(static_cast<size_t>(sy) * image.width + sx) * image.channels + c]; };
+                result.pixels[(static_cast<size_t>(y) * result.width + x) * result.channels + c] = static_cast<uint8_t>((at(x0, y0) + at(x1, y0) + at(x0, y1) + at(x1, y1) + 2) / 4);
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * True if the image has one channel or all its pixels are gray, with some
+ * tolerance for the color noise of JPEG.
+ */
+static bool isGray(const Image &image)
+{
+    if (image.channels < 3) return true;
+    for (size_t i = 0; i < image.pixels.size(); i += image.channels)
+    {
+        const uint8_t *pixel = &image.pixels[i];
+        if (std::abs(pixel[0] - pixel[1]) > 8 || std::abs(pixel[1] - pixel[2]) > 8) return false;
+    }
+    return true;
+}
+
+/**
+ * Peak signal to noise ratio of the first channels of the original against
+ * the decoded blocks, in decibels.
+ */
+static double getPSNR(const Image &image, const std::vector<uint8_t> &decoded, int decodedChannels)
+{
+    double sum = 0.0;
+    size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+    int channels = std::min(image.channels, decodedChannels);
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            double difference = image.pixels[i * image.channels + c] - decoded[i * decodedChannels + c];
+            sum += difference * difference;
+        }
+    }
+    double meanSquaredError = sum / (pixelCount * channels);
+    return meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : 99.0;
+}
+
+/**
+ * Writes the image with all its mipmaps to a DDS file next to it.
+ *
+ * @param automatic Picks BC4 for gray images instead of the given format.
+ */
+static void convert(const std::string &filename, Format format, bool automatic, unsigned threadCount)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    Image image;
+    uint8_t *data = stbi_load(filename.c_str(), &image.width, &image.height, &image.channels, 0);
+    if (!data)
+    {
+        throw std::runtime_error("Failed to load " + filename + ": " + stbi_failure_reason());
+    }
+    image.pixels.assign(data, data + static_cast<size_t>(image.width) * image.height * image.channels);
+    stbi_image_free(data);
+
+    if (automatic)
+    {
+        format = isGray(image) ? Format::BC4 : Format::BC1;
+    }
+
+    DDSHeader header;
+    header.width = image.width;
+    header.height = image.height;
+    header.linearSize = static_cast<uint32_t>(BlockCompression::getSize(image.width, image.height));
+    std::memcpy(header.fourCC, format == Format::BC1 ? "DXT1" : "ATI1", 4);
+
+    std::string outputFilename = std::filesystem::path(filename).replace_extension(".dds").string();
+    std::ofstream file(outputFilename, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to create " + outputFilename);
+    }
+    file.write("DDS ", 4);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    double psnr = 0.0;
+    size_t size = 0;
+    Image level = image;
+    while (true)
+    {
+        std::vector<uint8_t> blocks = BlockCompression::encode(format, level.pixels.data(), level.width, level.height, level.channels, threadCount);
+        if (header.mipMapCount == 0)
+        {
+            psnr = getPSNR(level, BlockCompression::decode(format, blocks.data(), level.width, level.height), format == Format::BC1 ? 3 : 1);
+        }
+        file.write(reinterpret_cast<const char *>(blocks.data()), static_cast<std::streamsize>(blocks.size()));
+        size += blocks.size();
+        header.mipMapCount++;
+        if (level.width == 1 && level.height == 1) break;
+        level = downsample(level);
+    }
+
+    file.seekp(4 + offsetof(DDSHeader, mipMapCount));
+    file.write(reinterpret_cast<const char *>(&header.mipMapCount), sizeof(header.mipMapCount));
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write " + outputFilename);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << outputFilename << ": " << image.width << "x" << image.height << " " << (format == Format::BC1 ? "BC1" : "BC4") << ", "
+              << header.mipMapCount << " levels, " << size / 1024 << " KiB, PSNR " << psnr << " dB, " << seconds << " s" << std::endl;
+}
+
+/**
+ * Converts images to block compressed DDS files with mipmaps, which the
+ * renderer loads instead of the original images when they are present.
+ */
+int main(int argc, char **argv)
+{
+    Format format = Format::BC1;
+    bool automatic = true;
+    unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> filenames;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--bc1" || argument == "--bc4")
+        {
+            format = argument == "--bc1" ? Format::BC1 : Format::BC4;
+            automatic = false;
+        }
+        else if (argument == "--threads" && i + 1 < argc)
+        {
+            threadCount = std::max(1, std::atoi(argv[++i]));
+        }
+        else
+        {
+            filenames.push_back(argument);
+        }
+    }
+
+    if (filenames.empty())
+    {
+        std::cerr << "Usage: texconv [--bc1 | --bc4] [--threads N] image..." << std::endl;
+        std::cerr << "Writes image.dds next to every image, BC4 for gray images and BC1 otherwise." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        for (const std::string &filename : filenames)
+        {
+            convert(filename, format, automatic, threadCount);
+        }
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,215 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Header of a .mips file, all values in native byte order. The levels
+ * follow at dataOffset without gaps, largest first, each bottom row first
+ * with tightly packed rows.
+ */
+struct MipmapHeader
+{
+    char magic[8] = {'C', 'G', 'B', 'M', 'I', 'P', 'S', 0};
+    uint32_t version = 1;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t channels = 0;
+    uint32_t levels = 0;
+    uint32_t dataOffset = 64;
+};
+
+/** Pixels as floats, linear unless filtered without gamma correction. */
+struct Level
+{
+    int width;
+    int height;
+    std::vector<float> values;
+};
+
+static float toLinear(float value)
+{
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float toSRGB(float value)
+{
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+/**
+ * Halves the level with a box filter. Odd sizes repeat the last row or column.
+ */
+static Level downsample(const Level &level, int channels)
+{
+    Level result{std::max(1, level.width / 2), std::max(1, level.height / 2), {}};
+    result.values.resize(static_cast<size_t>(result.width) * result.height * channels);
+    for (int y = 0; y < result.height; y++)
+    {
+        int y0 = std::min(y * 2, level.height - 1), y1 = std::min(y * 2 + 1, level.height - 1);
+        for (int x = 0; x < result.width; x++)
+        {
+            int x0 = std::min(x * 2, level.width - 1), x1 = std::min(x * 2 + 1, level.width - 1);
+            for (int c = 0; c < channels; c++)
+            {
+                auto at = [&](int sx, int sy) { return level.values[(static_cast<size_t>(sy) * level.width + sx) * channels + c]; };
+                result.values[(static_cast<size_t>(y) * result.width + x) * channels + c] = (at(x0, y0) + at(x1, y0) + at(x0, y1) + at(x1, y1)) * 0.25f;
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * Writes the image with all its mipmaps to a .mips file next to it.
+ *
+ * @param gammaCorrect Averages colors in linear space, which keeps bright
+ *                     details from fading in the smaller levels. Alpha and
+ *                     data like specular masks are always averaged as stored.
+ */
+static void pack(const std::string &filename, bool gammaCorrect)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load(1);
+    uint8_t *data = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+    if (!data)
+    {
+        throw std::runtime_error("Failed to load " + filename + ": " + stbi_failure_reason());
+    }
+
+    // Luminance and color channels are gamma encoded, a second or fourth channel is alpha
+    int colorChannels = channels == 2 || channels == 4 ? channels - 1 : channels;
+    float toLinearTable[256];
+    for (int i = 0; i < 256; i++)
+    {
+        toLinearTable[i] = gammaCorrect ? toLinear(i / 255.0f) : i / 255.0f;
+    }
+
+    Level level{width, height, {}};
+    level.values.resize(static_cast<size_t>(width) * height * channels);
+    for (size_t i = 0; i < level.values.size(); i++)
+    {
+        level.values[i] = static_cast<int>(i % channels) < colorChannels ? toLinearTable[data[i]] : data[i] / 255.0f;
+    }
+    stbi_image_free(data);
+
+    MipmapHeader header;
+    header.width = width;
+    header.height = height;
+    header.channels = channels;
+
+    std::string outputFilename = std::filesystem::path(filename).replace_extension(".mips").string();
+    std::ofstream file(outputFilename, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to create " + outputFilename);
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.seekp(header.dataOffset);
+
+    std::vector<uint8_t> pixels;
+    size_t size = 0;
+    while (true)
+    {
+        pixels.resize(level.values.size());
+        for (size_t i = 0; i < pixels.size(); i++)
+        {
+            float value = level.values[i];
+            if (gammaCorrect && static_cast<int>(i % channels) < colorChannels) value = toSRGB(value);
+            pixels[i] = static_cast<uint8_t>(std::clamp(value * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+        file.write(reinterpret_cast<const char *>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+        size += pixels.size();
+        header.levels++;
+        if (level.width == 1 && level.height == 1) break;
+        level = downsample(level, channels);
+    }
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write " + outputFilename);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << outputFilename << ": " << width << "x" << height << ", " << channels << " channels, " << header.levels << " levels, "
+              << size / 1024 << " KiB, " << seconds << " s" << std::endl;
+}
+
+/**
+ * Packs images with all their mipmaps into .mips files, which the renderer
+ * maps and uploads instead of decoding the original images.
+ */
+int main(int argc, char **argv)
+{
+    bool gammaCorrect = true;
+    std::vector<std::string> filenames;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--linear")
+        {
+            gammaCorrect = false;
+        }
+        else
+        {
+            filenames.push_back(argument);
+        }
+    }
+
+    if (filenames.empty())
+    {
+        std::cerr << "Usage: texpack [--linear] image..." << std::endl;
+        std::cerr << "Writes image.mips next to every image. --linear averages without gamma correction, for data like specular masks." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        for (const std::string &filename : filenames)
+        {
+            pack(filename, gammaCorrect);
+        }
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,245 @@
+/**
+ * Grundlagen der Computergrafik
+ * Copyright © 2021-2024 Tobias Reimann
+ * Copyright © 2024 Lukas Scheurer: Rewritten in C++
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Header of a .tiles file, all values in native byte order. The tiles follow
+ * at dataOffset without gaps, level after level starting with the largest,
+ * row after row starting at the bottom. Every tile is tileSize texels wide
+ * and high, including a border of texels repeated from its neighbors, so
+ * bilinear filtering within a tile matches filtering the whole level.
+ */
+struct TileHeader
+{
+    char magic[8] = {'C', 'G', 'B', 'T', 'I', 'L', 'E', 'S'};
+    uint32_t version = 1;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t channels = 0;
+    uint32_t tileSize = 256;
+    uint32_t border = 1;
+    uint32_t levels = 0;
+    uint32_t dataOffset = 64;
+};
+
+struct Level
+{
+    int width;
+    int height;
+    std::vector<uint8_t> pixels;
+};
+
+static float toLinear(float value)
+{
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float toSRGB(float value)
+{
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+/**
+ * Halves the level with a box filter, rounding odd sizes up. Texel i of the
+ * result covers texels 2i and 2i + 1, the last one repeated past the edge,
+ * so every level maps texture coordinates the same way.
+ */
+static Level downsample(const Level &level, int channels, int colorChannels, const float *toLinearTable, bool gammaCorrect)
+{
+    Level result{(level.width + 1) / 2, (level.height + 1) / 2, {}};
+    result.pixels.resize(static_cast<size_t>(result.width) * result.height * channels);
+    for (int y = 0; y < result.height; y++)
+    {
+        int y0 = y * 2, y1 = std::min(y * 2 + 1, level.height - 1);
+        for (int x = 0; x < result.width; x++)
+        {
+            int x0 = x * 2, x1 = std::min(x * 2 + 1, level.width - 1);
+            for (int c = 0; c < channels; c++)
+            {
+                auto at = [&](int sx, int sy) { return level.pixels[(static_cast<size_t>(sy) * level.width + sx) * channels + c]; };
+                float value;
+                if (gammaCorrect && c < colorChannels)
+                {
+                    value = toSRGB((toLinearTable[at(x0, y0)] + toLinearTable[at(x1, y0)] + toLinearTable[at(x0, y1)] + toLinearTable[at(x1, y1)]) * 0.25f);
+                }
+                else
+                {
+                    value = (at(x0, y0) + at(x1, y0) + at(x0, y1) + at(x1, y1)) / (4.0f * 255.0f);
+                }
+                result.pixels[(static_cast<size_t>(y) * result.width + x) * channels + c] = static_cast<uint8_t>(std::clamp(value * 255.0f + 0.5f, 0.0f, 255.0f));
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * Cuts the level into tiles and appends them to the file. Texels outside of
+ * the level repeat its edge.
+ */
+static size_t writeTiles(std::ofstream &file, const Level &level, const TileHeader &header)
+{
+    int tileSize = static_cast<int>(header.tileSize), border = static_cast<int>(header.border), channels = static_cast<int>(header.channels);
+    int content = tileSize - 2 * border;
+    int tilesX = (level.width + content - 1) / content, tilesY = (level.height + content - 1) / content;
+    std::vector<uint8_t> tile(static_cast<size_t>(tileSize) * tileSize * channels);
+    for (int tileY = 0; tileY < tilesY; tileY++)
+    {
+        for (int tileX = 0; tileX < tilesX; tileX++)
+        {
+            for (int y = 0; y < tileSize; y++)
+            {
+                int sourceY = std::clamp(tileY * content + y - border, 0, level.height - 1);
+                for (int x = 0; x < tileSize; x++)
+                {
+                    int sourceX = std::clamp(tileX * content + x - border, 0, level.width - 1);
+                    const uint8_t *source = &level.pixels[(static_cast<size_t>(sourceY) * level.width + sourceX) * channels];
+                    std::copy(source, source + channels, &tile[(static_cast<size_t>(y) * tileSize + x) * channels]);
+                }
+            }
+            file.write(reinterpret_cast<const char *>(tile.data()), static_cast<std::streamsize>(tile.size()));
+        }
+    }
+    return static_cast<size_t>(tilesX) * tilesY;
+}
+
+/**
+ * Writes the mipmap pyramid of the image as tiles to a .tiles file next to
+ * it, down to the level that fits into a single tile. Only two levels are
+ * held in memory at a time.
+ *
+ * @param gammaCorrect Averages colors in linear space, see texpack.
+ */
+static void pack(const std::string &filename, bool gammaCorrect)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load(1);
+    uint8_t *data = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+    if (!data)
+    {
+        throw std::runtime_error("Failed to load " + filename + ": " + stbi_failure_reason());
+    }
+    Level level{width, height, std::vector<uint8_t>(data, data + static_cast<size_t>(width) * height * channels)};
+    stbi_image_free(data);
+
+    // Luminance and color channels are gamma encoded, a second or fourth channel is alpha
+    int colorChannels = channels == 2 || channels == 4 ? channels - 1 : channels;
+    float toLinearTable[256];
+    for (int i = 0; i < 256; i++)
+    {
+        toLinearTable[i] = toLinear(i / 255.0f);
+    }
+
+    TileHeader header;
+    header.width = width;
+    header.height = height;
+    header.channels = channels;
+    int content = static_cast<int>(header.tileSize - 2 * header.border);
+
+    std::string outputFilename = std::filesystem::path(filename).replace_extension(".tiles").string();
+    std::ofstream file(outputFilename, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to create " + outputFilename);
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.seekp(header.dataOffset);
+
+    size_t tiles = 0;
+    while (true)
+    {
+        tiles += writeTiles(file, level, header);
+        header.levels++;
+        if (level.width <= content && level.height <= content) break;
+        level = downsample(level, channels, colorChannels, toLinearTable, gammaCorrect);
+    }
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write " + outputFilename);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    size_t size = tiles * header.tileSize * header.tileSize * channels;
+    std::cout << outputFilename << ": " << width << "x" << height << ", " << channels << " channels, " << header.levels << " levels, " << tiles
+              << " tiles, " << size / (1024 * 1024) << " MiB, " << seconds << " s" << std::endl;
+}
+
+/**
+ * Cuts images into tiles of a mipmap pyramid in .tiles files, which the
+ * renderer streams as virtual textures, however large the images are.
+ */
+int main(int argc, char **argv)
+{
+    bool gammaCorrect = true;
+    std::vector<std::string> filenames;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--linear")
+        {
+            gammaCorrect = false;
+        }
+        else
+        {
+            filenames.push_back(argument);
+        }
+    }
+
+    if (filenames.empty())
+    {
+        std::cerr << "Usage: tilepack [--linear] image..." << std::endl;
+        std::cerr << "Writes image.tiles next to every image. --linear averages without gamma correction, for data like specular masks." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        for (const std::string &filename : filenames)
+        {
+            pack(filename, gammaCorrect);
+        }
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}